@@ -0,0 +1,115 @@
+// Loopback connection rate through an AcceptorGroup of 1, 2, 4, ... loops.
+//
+// kClients threads connect to 127.0.0.1 and close again as fast as they
+// can for kDuration; each loop owns a SO_REUSEPORT listener, accepts in
+// batches and closes every connection right away. The rate counts
+// connections accepted by the servers.
+
+#include "Acceptor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+using Clock = ms::RunLoop::Clock;
+using namespace std::chrono_literals;
+
+namespace
+{
+    constexpr int kClients = 8;
+    constexpr auto kDuration = 1s;
+
+    double measure(size_t loopCount)
+    {
+        std::vector<std::unique_ptr<ms::RunLoop>> loops;
+        std::vector<ms::RunLoop *> loopPtrs;
+        for (size_t i = 0; i < loopCount; ++i)
+        {
+            loops.push_back(std::make_unique<ms::RunLoop>());
+            loops.back()->init("AcceptRate");
+            loopPtrs.push_back(loops.back().get());
+        }
+
+        std::atomic<uint64_t> accepted{0};
+        ms::AcceptorGroup group;
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (!group.listen(loopPtrs, reinterpret_cast<const sockaddr *>(&address), sizeof(address),
+                          [&](size_t, int fd) {
+                              close(fd);
+                              accepted.fetch_add(1, std::memory_order_relaxed);
+                          }))
+        {
+            std::perror("listen");
+            return 0;
+        }
+
+        std::vector<std::thread> loopThreads;
+        for (auto *loop : loopPtrs)
+        {
+            loopThreads.emplace_back([loop] { loop->run(); });
+        }
+
+        sockaddr_in server = address;
+        server.sin_port = htons(group.port());
+        std::atomic<bool> done{false};
+        std::vector<std::thread> clients;
+        for (int i = 0; i < kClients; ++i)
+        {
+            clients.emplace_back([&] {
+                while (!done.load(std::memory_order_relaxed))
+                {
+                    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                    // Reset on close instead of leaving TIME_WAIT behind, so
+                    // the run does not exhaust ephemeral ports.
+                    linger lg{1, 0};
+                    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+                    connect(fd, reinterpret_cast<const sockaddr *>(&server), sizeof(server));
+                    close(fd);
+                }
+            });
+        }
+
+        uint64_t before = accepted.load();
+        auto start = Clock::now();
+        std::this_thread::sleep_for(kDuration);
+        uint64_t count = accepted.load() - before;
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        done.store(true);
+        for (auto &client : clients)
+        {
+            client.join();
+        }
+        for (auto *loop : loopPtrs)
+        {
+            loop->stop();
+        }
+        for (auto &thread : loopThreads)
+        {
+            thread.join();
+        }
+        return static_cast<double>(count) / seconds;
+    }
+} // namespace
+
+int main()
+{
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%-8s %14s   (%d client threads, %u cores)\n", "loops", "conn/s", kClients, cores);
+
+    for (size_t loops = 1; loops <= 8; loops *= 2)
+    {
+        std::printf("%-8zu %14.0f\n", loops, measure(loops));
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+// Thundering herd: loop wakeups per event when 8 loops watch one eventfd.
+//
+// A producer signals a shared eventfd once per event and waits until one
+// loop has consumed it. With addSource() every loop blocked on the fd is
+// woken; with addSharedSource() (EPOLLEXCLUSIVE) only one is. Wakeups are
+// counted as voluntary context switches of the loop threads, which also
+// catches wakeups that find nothing to do and go straight back to sleep
+// inside epoll_wait, as well as handler calls that hit EAGAIN.
+
+#include "RunLoop.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    constexpr int kLoops = 8;
+    constexpr int kEvents = 2000;
+
+    struct Result
+    {
+        double wakeups; // per event
+        double wasted;  // handler calls that found nothing, per event
+    };
+
+    long threadSwitches()
+    {
+        rusage usage{};
+        getrusage(RUSAGE_THREAD, &usage);
+        return usage.ru_nvcsw;
+    }
+
+    long loopSwitches(std::vector<std::unique_ptr<ms::RunLoop>> &loops)
+    {
+        long total = 0;
+        for (auto &loop : loops)
+        {
+            total += loop->executeAndWait([] { return threadSwitches(); });
+        }
+        return total;
+    }
+
+    Result measure(bool shared)
+    {
+        int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        std::atomic<int> handled{0};
+        std::atomic<int> wasted{0};
+
+        std::vector<std::unique_ptr<ms::RunLoop>> loops;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kLoops; ++i)
+        {
+            loops.push_back(std::make_unique<ms::RunLoop>());
+            loops.back()->init("SharedWakeups");
+            auto handler = [&] {
+                uint64_t value;
+                if (read(efd, &value, sizeof(value)) == sizeof(value))
+                {
+                    handled.fetch_add(1, std::memory_order_release);
+                }
+                else
+                {
+                    wasted.fetch_add(1, std::memory_order_relaxed);
+                }
+            };
+            if (shared)
+            {
+                loops.back()->addSharedSource(efd, handler);
+            }
+            else
+            {
+                loops.back()->addSource(efd, handler);
+            }
+            threads.emplace_back([loop = loops.back().get()] { loop->run(); });
+        }
+        std::this_thread::sleep_for(20ms);
+
+        // The switch counts are read through posts, which cost one wakeup
+        // per loop each time; subtract that baseline.
+        long before = loopSwitches(loops);
+        long baseline = loopSwitches(loops) - before;
+        before = loopSwitches(loops);
+
+        for (int i = 0; i < kEvents; ++i)
+        {
+            uint64_t one = 1;
+            [[maybe_unused]] auto r = write(efd, &one, sizeof(one));
+            while (handled.load(std::memory_order_acquire) <= i)
+            {
+                std::this_thread::yield();
+            }
+            // Let every woken loop go back to sleep before the next event.
+            std::this_thread::sleep_for(50us);
+        }
+        long switches = loopSwitches(loops) - before - baseline;
+
+        for (int i = 0; i < kLoops; ++i)
+        {
+            loops[i]->stop();
+            threads[i].join();
+        }
+        close(efd);
+        return {static_cast<double>(switches) / kEvents, static_cast<double>(wasted.load()) / kEvents};
+    }
+} // namespace
+
+int main()
+{
+    std::printf("%-22s %14s %14s   (%d loops, %d events)\n", "registration", "wakeups/event", "empty/event",
+                kLoops, kEvents);
+
+    for (bool shared : {false, true})
+    {
+        Result r = measure(shared);
+        std::printf("%-22s %14.2f %14.2f\n", shared ? "addSharedSource" : "addSource", r.wakeups, r.wasted);
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Per-event cost of fd source dispatch: std::function vs typed handlers.
+//
+// kSources pipes are each left holding one unread byte, so with
+// level-triggered epoll every source is ready on every iteration and the
+// loop does nothing but wait and dispatch. The wall time per dispatched
+// event covers epoll_wait (amortised over a batch), the source lookup
+// and the call itself.
+
+#include "RunLoop.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using Clock = ms::RunLoop::Clock;
+
+namespace
+{
+    constexpr int kSources = 64;
+    constexpr uint64_t kEvents = 2'000'000;
+    constexpr int kRounds = 3;
+
+    struct Pipes
+    {
+        std::vector<int> readFds;
+        std::vector<int> writeFds;
+
+        Pipes()
+        {
+            for (int i = 0; i < kSources; ++i)
+            {
+                int fds[2];
+                if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+                {
+                    std::perror("pipe2");
+                    return;
+                }
+                char byte = 1;
+                [[maybe_unused]] auto r = write(fds[1], &byte, 1);
+                readFds.push_back(fds[0]);
+                writeFds.push_back(fds[1]);
+            }
+        }
+
+        ~Pipes()
+        {
+            for (int fd : readFds)
+            {
+                close(fd);
+            }
+            for (int fd : writeFds)
+            {
+                close(fd);
+            }
+        }
+    };
+
+    struct Counter
+    {
+        ms::RunLoop &loop;
+        uint64_t count = 0;
+
+        void hit()
+        {
+            if (++count == kEvents)
+            {
+                loop.stop();
+            }
+        }
+    };
+
+    // Typed handler: the call goes straight to operator() via a trampoline.
+    struct TypedHandler
+    {
+        Counter *counter;
+        void operator()() { counter->hit(); }
+    };
+
+    enum class Mode
+    {
+        SmallFunction, // std::function with an inline-stored capture
+        LargeFunction, // std::function whose capture is heap-allocated
+        Typed,         // addSource(fd, Handler *)
+    };
+
+    const char *modeName(Mode mode)
+    {
+        switch (mode)
+        {
+        case Mode::SmallFunction:
+            return "std::function (small)";
+        case Mode::LargeFunction:
+            return "std::function (large)";
+        default:
+            return "typed handler";
+        }
+    }
+
+    double measure(Mode mode)
+    {
+        Pipes pipes;
+        ms::RunLoop loop;
+        loop.init("SourceDispatch");
+        Counter counter{loop};
+
+        std::vector<TypedHandler> handlers(kSources, TypedHandler{&counter});
+        for (int i = 0; i < kSources; ++i)
+        {
+            int fd = pipes.readFds[i];
+            switch (mode)
+            {
+            case Mode::SmallFunction:
+                loop.addSource(fd, [&counter] { counter.hit(); });
+                break;
+            case Mode::LargeFunction:
+            {
+                std::array<uint64_t, 8> state{};
+                loop.addSource(fd, [&counter, state] {
+                    if (state[0] == 0)
+                    {
+                        counter.hit();
+                    }
+                });
+                break;
+            }
+            case Mode::Typed:
+                loop.addSource(fd, &handlers[i]);
+                break;
+            }
+        }
+
+        auto start = Clock::now();
+        loop.run();
+        auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        return elapsed / static_cast<double>(counter.count);
+    }
+} // namespace
+
+int main()
+{
+    std::printf("%-24s %12s   (%d ready sources, %llu events, best of %d)\n", "handler", "ns/event",
+                kSources, static_cast<unsigned long long>(kEvents), kRounds);
+
+    for (auto mode : {Mode::SmallFunction, Mode::LargeFunction, Mode::Typed})
+    {
+        double best = 0;
+        for (int round = 0; round < kRounds; ++round)
+        {
+            double ns = measure(mode);
+            if (round == 0 || ns < best)
+            {
+                best = ns;
+            }
+        }
+        std::printf("%-24s %12.1f\n", modeName(mode), best);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Small-message output rate: one write() per message versus a
+// StreamConnection that gathers each turn's messages into one sendmsg().
+//
+// Every turn of the loop queues kBurst 64-byte messages on one end of a
+// Unix socketpair; a reader thread drains the other end. The rate counts
+// messages per second of wall time, and the write column the syscalls
+// spent per message.
+
+#include "StreamConnection.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Clock = ms::RunLoop::Clock;
+
+namespace
+{
+    constexpr int kBurst = 32;
+    constexpr int kTurns = 20000;
+    constexpr size_t kMessageSize = 64;
+
+    struct Result
+    {
+        double messagesPerSecond;
+        double writesPerMessage;
+    };
+
+    Result measure(bool buffered)
+    {
+        int fds[2];
+        socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+        const size_t total = static_cast<size_t>(kBurst) * kTurns * kMessageSize;
+
+        std::thread reader([fd = fds[1], total] {
+            char buf[64 * 1024];
+            size_t received = 0;
+            while (received < total)
+            {
+                ssize_t n = read(fd, buf, sizeof(buf));
+                if (n <= 0)
+                {
+                    break;
+                }
+                received += static_cast<size_t>(n);
+            }
+        });
+
+        ms::RunLoop loop;
+        loop.init("StreamWrites");
+        ms::StreamConnection conn;
+        char message[kMessageSize] = {};
+        uint64_t writes = 0;
+        int turns = 0;
+
+        // One burst per turn, re-posted until done.
+        std::function<void()> turn = [&] {
+            for (int i = 0; i < kBurst; ++i)
+            {
+                if (buffered)
+                {
+                    conn.send(message, sizeof(message));
+                }
+                else
+                {
+                    // Blocking fd: a plain write() per message.
+                    [[maybe_unused]] auto r = write(fds[0], message, sizeof(message));
+                    ++writes;
+                }
+            }
+            if (++turns < kTurns)
+            {
+                loop.executeOnRunLoop(turn);
+            }
+            else if (buffered)
+            {
+                conn.flush();
+                loop.executeOnRunLoop([&] { loop.stop(); });
+            }
+            else
+            {
+                loop.stop();
+            }
+        };
+
+        auto start = Clock::now();
+        loop.executeOnRunLoop([&] {
+            if (buffered)
+            {
+                conn.open(
+                    loop, fds[0], [](const char *, size_t size) { return size; }, [](int) {});
+            }
+            turn();
+        });
+        loop.run();
+        // Buffered output still queued behind EPOLLOUT drains here.
+        while (buffered && conn.pendingOutput() > 0)
+        {
+            loop.executeOnRunLoop([&] { loop.stop(); });
+            loop.run();
+        }
+        reader.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (buffered)
+        {
+            writes = conn.stats().writes;
+            conn.close();
+        }
+        else
+        {
+            close(fds[0]);
+        }
+        close(fds[1]);
+        double messages = static_cast<double>(kBurst) * kTurns;
+        return {messages / seconds, static_cast<double>(writes) / messages};
+    }
+} // namespace
+
+int main()
+{
+    std::printf("%-18s %14s %14s   (%d x %zu-byte messages per turn)\n", "output", "msgs/s", "writes/msg", kBurst,
+                kMessageSize);
+
+    for (bool buffered : {false, true})
+    {
+        Result r = measure(buffered);
+        std::printf("%-18s %14.0f %14.3f\n", buffered ? "StreamConnection" : "write() each", r.messagesPerSecond,
+                    r.writesPerMessage);
+    }
+    return 0;
+}
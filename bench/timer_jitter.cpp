@@ -0,0 +1,136 @@
+// Timer firing jitter per timer backend, on an idle and on a loaded loop.
+//
+// A 100 µs one-shot timer is re-armed from its own callback N times; the
+// lateness of each firing (actual - requested deadline) is recorded.
+// "Loaded" adds producer threads flooding the loop with small posts.
+
+#include "RunLoop.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using Clock = ms::RunLoop::Clock;
+using namespace std::chrono_literals;
+
+namespace
+{
+    constexpr int kSamples = 2000;
+    constexpr auto kPeriod = 100us;
+    constexpr int kProducers = 2;
+
+    struct Result
+    {
+        double p50;
+        double p99;
+        double max;
+    };
+
+    const char *backendName(ms::RunLoop::TimerResolution r)
+    {
+        switch (r)
+        {
+        case ms::RunLoop::TimerResolution::Millisecond:
+            return "Millisecond";
+        case ms::RunLoop::TimerResolution::EpollPwait2:
+            return "EpollPwait2";
+        case ms::RunLoop::TimerResolution::TimerFd:
+            return "TimerFd";
+        default:
+            return "High";
+        }
+    }
+
+    Result measure(ms::RunLoop::TimerResolution resolution, bool loaded, ms::RunLoop::TimerResolution &used)
+    {
+        ms::RunLoop loop;
+        ms::RunLoop::Options options;
+        options.timerResolution = resolution;
+        loop.init("TimerJitter", options);
+        used = loop.timerResolution();
+
+        std::vector<double> lateness;
+        lateness.reserve(kSamples);
+        std::atomic<bool> done{false};
+
+        std::thread loopThread([&] { loop.run(); });
+
+        std::vector<std::thread> producers;
+        if (loaded)
+        {
+            for (int p = 0; p < kProducers; ++p)
+            {
+                producers.emplace_back([&] {
+                    while (!done.load(std::memory_order_relaxed))
+                    {
+                        loop.executeOnRunLoop([] {
+                            auto until = Clock::now() + 2us;
+                            while (Clock::now() < until) {}
+                        });
+                        std::this_thread::sleep_for(20us);
+                    }
+                });
+            }
+        }
+
+        std::function<void()> arm;
+        Clock::time_point deadline;
+        arm = [&] {
+            deadline = Clock::now() + kPeriod;
+            loop.executeAfter(kPeriod, [&] {
+                auto late = std::chrono::duration<double, std::micro>(Clock::now() - deadline).count();
+                lateness.push_back(late);
+                if (lateness.size() < kSamples)
+                {
+                    arm();
+                }
+                else
+                {
+                    done.store(true);
+                }
+            });
+        };
+        loop.executeOnRunLoop(arm);
+
+        while (!done.load())
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+        for (auto &t : producers)
+        {
+            t.join();
+        }
+        loop.stop();
+        loopThread.join();
+
+        std::sort(lateness.begin(), lateness.end());
+        return {lateness[lateness.size() / 2], lateness[lateness.size() * 99 / 100], lateness.back()};
+    }
+} // namespace
+
+int main()
+{
+    std::printf("%-12s %-7s %10s %10s %10s   (lateness of a %lld us timer, us)\n", "backend", "load",
+                "p50", "p99", "max", static_cast<long long>(kPeriod.count()));
+
+    for (auto resolution : {ms::RunLoop::TimerResolution::Millisecond, ms::RunLoop::TimerResolution::EpollPwait2,
+                            ms::RunLoop::TimerResolution::TimerFd})
+    {
+        for (bool loaded : {false, true})
+        {
+            ms::RunLoop::TimerResolution used;
+            Result r = measure(resolution, loaded, used);
+            if (used != resolution)
+            {
+                std::printf("%-12s unavailable, fell back to %s\n", backendName(resolution), backendName(used));
+                break;
+            }
+            std::printf("%-12s %-7s %10.1f %10.1f %10.1f\n", backendName(used), loaded ? "loaded" : "idle",
+                        r.p50, r.p99, r.max);
+        }
+    }
+    return 0;
+}
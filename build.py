@@ -7,6 +7,7 @@ Usage:
   python build.py -c              # clean build
   python build.py -t              # build + run tests
   python build.py -e              # build + examples
+  python build.py -b              # build + benchmarks (Release)
   python build.py -c -t -e        # clean build + tests + examples
 """
 
@@ -35,7 +36,7 @@ def clean():
         print(">>> Nothing to clean")
 
 
-def configure(examples=False):
+def configure(examples=False, benchmarks=False):
     os.makedirs(BUILD_DIR, exist_ok=True)
     cmd = [
         "cmake",
@@ -45,6 +46,8 @@ def configure(examples=False):
     ]
     if examples:
         cmd.append("-DMS_RUNLOOP_BUILD_EXAMPLES=ON")
+    if benchmarks:
+        cmd.append("-DMS_RUNLOOP_BUILD_BENCHMARKS=ON")
     run(cmd, cwd=SCRIPT_DIR)
 
 
@@ -61,14 +64,15 @@ def main():
     parser.add_argument("-c", "--clean", action="store_true", help="Clean build directory")
     parser.add_argument("-t", "--test", action="store_true", help="Build and run tests")
     parser.add_argument("-e", "--examples", action="store_true", help="Build examples")
+    parser.add_argument("-b", "--benchmarks", action="store_true", help="Build benchmarks")
     args = parser.parse_args()
 
     if args.clean:
         clean()
-        if not args.test and not args.examples:
+        if not args.test and not args.examples and not args.benchmarks:
             return
 
-    configure(examples=args.examples)
+    configure(examples=args.examples, benchmarks=args.benchmarks)
     build()
 
     if args.test:
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "RunLoop.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace ms
+{
+
+    // Listening socket driven by a run loop. Each readiness event drains
+    // the accept queue with accept4() up to a budget, instead of taking
+    // one connection per wakeup; whatever exceeds the budget is picked up
+    // on the next iteration (the listener is level-triggered). Accepted
+    // sockets are non-blocking and close-on-exec, and belong to the handler.
+    //
+    // Running out of fds (EMFILE/ENFILE) does not spin the loop: a spare
+    // fd is given up to accept the pending connection and close it at once.
+    // Without a spare (it could not be reopened) the listener is paused
+    // and retried after Options::fdRetryDelay.
+    //
+    // Destroy it on the loop thread or once the loop has stopped.
+    //
+    // Usage:
+    //   ms::Acceptor acceptor;
+    //   acceptor.listen(loop, addr, sizeof(addr), [](int fd) { serve(fd); });
+    class Acceptor
+    {
+    public:
+        struct Options
+        {
+            int backlog = SOMAXCONN;
+            size_t acceptBudget = 64; // connections accepted per readiness event
+            bool reusePort = false;   // SO_REUSEPORT; see AcceptorGroup
+            std::chrono::milliseconds fdRetryDelay{100}; // pause when out of fds and spares
+        };
+
+        struct Stats
+        {
+            uint64_t accepted = 0;
+            uint64_t readyEvents = 0; // wakeups of the listener
+            uint64_t dropped = 0;     // closed at once for lack of fds
+            uint64_t backoffs = 0;    // pauses for lack of fds, with no spare left
+        };
+
+        // Receives each accepted connection on the loop thread.
+        using Handler = std::function<void(int fd)>;
+
+        Acceptor() = default;
+        ~Acceptor();
+
+        Acceptor(const Acceptor &) = delete;
+        Acceptor &operator=(const Acceptor &) = delete;
+
+        // Bind and listen on `address` and start accepting on `loop`.
+        // Returns false with errno set if the socket could not be set up.
+        template <typename Loop>
+        bool listen(Loop &loop, const sockaddr *address, socklen_t length, Handler handler);
+        template <typename Loop>
+        bool listen(Loop &loop, const sockaddr *address, socklen_t length, Handler handler, const Options &options);
+
+        int fd() const { return m_fd; }
+
+        // Bound port, e.g. after listening on port 0. Host byte order.
+        uint16_t port() const;
+
+        // Thread-safe.
+        Stats stats() const;
+
+    private:
+        friend class AcceptorGroup;
+
+        bool open(const sockaddr *address, socklen_t length, const Options &options);
+        template <typename Loop>
+        void attach(Loop &loop, Handler handler);
+        void acceptReady();
+        void reopenSpare();
+        void close();
+
+        int m_fd = -1;
+        int m_spareFd = -1;
+        size_t m_acceptBudget = 0;
+        std::chrono::milliseconds m_fdRetryDelay{0};
+        Handler m_handler;
+        // Pauses the listener and resumes it after m_fdRetryDelay.
+        std::function<void()> m_backOff;
+        std::function<void()> m_detach;
+        // Cancelled on destruction; drops a pending retry.
+        CancelToken m_alive;
+
+        std::atomic<uint64_t> m_accepted{0};
+        std::atomic<uint64_t> m_readyEvents{0};
+        std::atomic<uint64_t> m_dropped{0};
+        std::atomic<uint64_t> m_backoffs{0};
+    };
+
+    // One SO_REUSEPORT listener per loop on the same address, so the
+    // kernel spreads incoming connections over the loops and each is
+    // accepted on the loop that will serve it, with no shared accept
+    // queue or cross-thread hand-off.
+    //
+    // The group spans several loop threads, so destroy it only after all
+    // of its loops have stopped.
+    //
+    // Usage:
+    //   ms::AcceptorGroup group;
+    //   group.listen(loops, addr, sizeof(addr), [](size_t loop, int fd) { ... });
+    class AcceptorGroup
+    {
+    public:
+        // Receives the index of the accepting loop and the connection.
+        using Handler = std::function<void(size_t loop, int fd)>;
+
+        // Port 0 picks a free port for the first listener and binds the
+        // others to the same one. Every socket is bound before any loop
+        // starts accepting, so on failure (false, errno set) nothing was
+        // registered with the loops and no listener is left open.
+        template <typename Loop>
+        bool listen(const std::vector<Loop *> &loops, const sockaddr *address, socklen_t length, Handler handler,
+                    Acceptor::Options options = Acceptor::Options());
+
+        size_t size() const { return m_acceptors.size(); }
+        const Acceptor &acceptor(size_t index) const { return *m_acceptors[index]; }
+        uint16_t port() const { return m_acceptors.empty() ? 0 : m_acceptors.front()->port(); }
+
+    private:
+        // Copy of `address` with the port replaced.
+        static std::vector<char> withPort(const sockaddr *address, socklen_t length, uint16_t port);
+
+        std::vector<std::unique_ptr<Acceptor>> m_acceptors;
+    };
+
+    template <typename Loop>
+    bool Acceptor::listen(Loop &loop, const sockaddr *address, socklen_t length, Handler handler)
+    {
+        return listen(loop, address, length, std::move(handler), Options());
+    }
+
+    template <typename Loop>
+    bool Acceptor::listen(Loop &loop, const sockaddr *address, socklen_t length, Handler handler,
+                          const Options &options)
+    {
+        if (!open(address, length, options))
+        {
+            return false;
+        }
+        attach(loop, std::move(handler));
+        return true;
+    }
+
+    template <typename Loop>
+    void Acceptor::attach(Loop &loop, Handler handler)
+    {
+        m_handler = std::move(handler);
+        loop.addSource(m_fd, [this] { acceptReady(); });
+        m_backOff = [&loop, this, fd = m_fd] {
+            loop.pauseSource(fd);
+            loop.executeAfter(
+                m_fdRetryDelay,
+                [&loop, this, fd] {
+                    reopenSpare();
+                    loop.resumeSource(fd);
+                },
+                m_alive);
+        };
+        m_detach = [&loop, fd = m_fd] { loop.removeSource(fd); };
+    }
+
+    template <typename Loop>
+    bool AcceptorGroup::listen(const std::vector<Loop *> &loops, const sockaddr *address, socklen_t length,
+                               Handler handler, Acceptor::Options options)
+    {
+        options.reusePort = true;
+        std::vector<char> bound(reinterpret_cast<const char *>(address),
+                                reinterpret_cast<const char *>(address) + length);
+        // Bind them all first: an acceptor that fails later is dropped
+        // before any loop has seen it.
+        std::vector<std::unique_ptr<Acceptor>> acceptors;
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            auto acceptor = std::make_unique<Acceptor>();
+            if (!acceptor->open(reinterpret_cast<const sockaddr *>(bound.data()), length, options))
+            {
+                return false;
+            }
+            if (i == 0)
+            {
+                bound = withPort(address, length, acceptor->port());
+            }
+            acceptors.push_back(std::move(acceptor));
+        }
+
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            acceptors[i]->attach(*loops[i], [handler, i](int fd) { handler(i, fd); });
+            m_acceptors.push_back(std::move(acceptors[i]));
+        }
+        return true;
+    }
+
+} // namespace ms
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace ms
+{
+
+    template <typename Policy>
+    class BasicRunLoop;
+
+    // Shared cancellation flag for posted callables and timers. Copies
+    // refer to the same flag, so one token can cover every piece of work
+    // belonging to a request. cancel() and isCancelled() are O(1) and
+    // thread-safe; cancelled work is skipped when the loop reaches it
+    // instead of being searched for in the queue.
+    //
+    // Usage:
+    //   ms::CancelToken token;
+    //   loop.executeOnRunLoop(stepOne, token);
+    //   loop.executeAfter(5s, timeout, token);
+    //   token.cancel();  // neither runs if it has not started yet
+    class CancelToken
+    {
+    public:
+        CancelToken() : m_state(std::make_shared<std::atomic<bool>>(false)) {}
+
+        void cancel() { m_state->store(true, std::memory_order_release); }
+        bool isCancelled() const { return m_state->load(std::memory_order_acquire); }
+
+    private:
+        template <typename Policy>
+        friend class BasicRunLoop;
+
+        std::shared_ptr<std::atomic<bool>> m_state;
+    };
+
+} // namespace ms
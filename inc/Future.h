@@ -0,0 +1,442 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace ms
+{
+
+    template <typename T>
+    class Future;
+
+    template <typename T>
+    class Promise;
+
+    namespace detail
+    {
+
+        struct Unit
+        {
+        };
+
+        template <typename T>
+        using FutureValue = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+        // Shared state between a Promise and its Future.
+        //
+        // States are recycled through a per-type free list instead of being
+        // freed, so a steady stream of post() calls reuses the same handful
+        // of states rather than allocating one per call like std::promise.
+        template <typename T>
+        class FutureState
+        {
+        public:
+            static constexpr size_t kMaxPooled = 1024;
+
+            static FutureState *acquire()
+            {
+                auto &pool = freeList();
+                {
+                    std::lock_guard<std::mutex> lock(pool.mutex);
+                    if (pool.head)
+                    {
+                        FutureState *state = pool.head;
+                        pool.head = state->m_next;
+                        --pool.size;
+                        state->m_next = nullptr;
+                        state->m_refs.store(1, std::memory_order_relaxed);
+                        state->m_producers.store(0, std::memory_order_relaxed);
+                        return state;
+                    }
+                }
+                return new FutureState();
+            }
+
+            void addRef() { m_refs.fetch_add(1, std::memory_order_relaxed); }
+
+            void release()
+            {
+                if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    recycle();
+                }
+            }
+
+            void addProducer() { m_producers.fetch_add(1, std::memory_order_relaxed); }
+
+            // The last Promise copy going away without a result breaks the promise.
+            void releaseProducer()
+            {
+                if (m_producers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    setException(std::make_exception_ptr(
+                        std::future_error(std::future_errc::broken_promise)));
+                }
+            }
+
+            template <typename... Args>
+            void setValue(Args &&...args)
+            {
+                std::function<void()> continuation;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_ready)
+                    {
+                        return;
+                    }
+                    m_value.emplace(std::forward<Args>(args)...);
+                    m_ready = true;
+                    continuation.swap(m_continuation);
+                }
+                m_cv.notify_all();
+                if (continuation)
+                {
+                    continuation();
+                }
+            }
+
+            void setException(std::exception_ptr error)
+            {
+                std::function<void()> continuation;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_ready)
+                    {
+                        return;
+                    }
+                    m_error = std::move(error);
+                    m_ready = true;
+                    continuation.swap(m_continuation);
+                }
+                m_cv.notify_all();
+                if (continuation)
+                {
+                    continuation();
+                }
+            }
+
+            // Run `fn` once the state is ready: immediately on the calling
+            // thread if it already is, otherwise on the completing thread.
+            void onReady(std::function<void()> fn)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (!m_ready)
+                    {
+                        m_continuation = std::move(fn);
+                        return;
+                    }
+                }
+                fn();
+            }
+
+            bool isReady()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_ready;
+            }
+
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this] { return m_ready; });
+            }
+
+            template <typename Rep, typename Period>
+            bool waitFor(const std::chrono::duration<Rep, Period> &timeout)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                return m_cv.wait_for(lock, timeout, [this] { return m_ready; });
+            }
+
+            // Only valid once ready. Moves the value out or rethrows.
+            FutureValue<T> take()
+            {
+                if (m_error)
+                {
+                    std::rethrow_exception(m_error);
+                }
+                return std::move(*m_value);
+            }
+
+            const std::exception_ptr &error() const { return m_error; }
+
+        private:
+            struct Pool
+            {
+                std::mutex mutex;
+                FutureState *head = nullptr;
+                size_t size = 0;
+            };
+
+            // Never destroyed: futures held by other static objects may be
+            // released after any static destructor has run.
+            static Pool &freeList()
+            {
+                static Pool *pool = new Pool;
+                return *pool;
+            }
+
+            void recycle()
+            {
+                m_value.reset();
+                m_error = nullptr;
+                m_continuation = nullptr;
+                m_ready = false;
+
+                auto &pool = freeList();
+                {
+                    std::lock_guard<std::mutex> lock(pool.mutex);
+                    if (pool.size < kMaxPooled)
+                    {
+                        m_next = pool.head;
+                        pool.head = this;
+                        ++pool.size;
+                        return;
+                    }
+                }
+                delete this;
+            }
+
+            std::atomic<uint32_t> m_refs{1};
+            std::atomic<uint32_t> m_producers{0};
+
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            bool m_ready = false;
+            std::optional<FutureValue<T>> m_value;
+            std::exception_ptr m_error;
+            std::function<void()> m_continuation;
+
+            FutureState *m_next = nullptr;
+        };
+
+        // Copyable intrusive reference to a FutureState.
+        template <typename T>
+        class StateRef
+        {
+        public:
+            StateRef() = default;
+            explicit StateRef(FutureState<T> *state) : m_state(state) {}
+            StateRef(const StateRef &other) : m_state(other.m_state)
+            {
+                if (m_state)
+                {
+                    m_state->addRef();
+                }
+            }
+            StateRef(StateRef &&other) noexcept : m_state(other.m_state) { other.m_state = nullptr; }
+            StateRef &operator=(StateRef other) noexcept
+            {
+                std::swap(m_state, other.m_state);
+                return *this;
+            }
+            ~StateRef()
+            {
+                if (m_state)
+                {
+                    m_state->release();
+                }
+            }
+
+            FutureState<T> *operator->() const { return m_state; }
+            explicit operator bool() const { return m_state != nullptr; }
+
+        private:
+            FutureState<T> *m_state = nullptr;
+        };
+
+        template <typename F, typename T>
+        struct ContinuationResult
+        {
+            using type = std::invoke_result_t<F, T>;
+        };
+
+        template <typename F>
+        struct ContinuationResult<F, void>
+        {
+            using type = std::invoke_result_t<F>;
+        };
+
+        // `fn` in a form std::function can hold: itself when copyable,
+        // otherwise a shared box around it.
+        template <typename F>
+        auto copyableCallable(F &&fn)
+        {
+            using Fn = std::decay_t<F>;
+            if constexpr (std::is_copy_constructible_v<Fn>)
+            {
+                return Fn(std::forward<F>(fn));
+            }
+            else
+            {
+                return [box = std::make_shared<Fn>(std::forward<F>(fn))](auto &&...args) -> decltype(auto) {
+                    return (*box)(std::forward<decltype(args)>(args)...);
+                };
+            }
+        }
+
+    } // namespace detail
+
+    // Producer side of a Future. Copyable so it can be captured by a
+    // std::function; the result is set by whichever copy gets there first.
+    // If every copy is destroyed without a result, the Future receives a
+    // std::future_error(broken_promise).
+    template <typename T>
+    class Promise
+    {
+    public:
+        Promise() : m_state(detail::FutureState<T>::acquire()) { m_state->addProducer(); }
+
+        Promise(const Promise &other) : m_state(other.m_state) { m_state->addProducer(); }
+        Promise(Promise &&other) noexcept = default;
+        Promise &operator=(const Promise &) = delete;
+        Promise &operator=(Promise &&) = delete;
+
+        ~Promise()
+        {
+            if (m_state)
+            {
+                m_state->releaseProducer();
+            }
+        }
+
+        // Returns the Future bound to this promise. Call once.
+        Future<T> future() { return Future<T>(m_state); }
+
+        template <typename... Args>
+        void setValue(Args &&...args)
+        {
+            m_state->setValue(std::forward<Args>(args)...);
+        }
+
+        void setException(std::exception_ptr error) { m_state->setException(std::move(error)); }
+
+        // Invoke `fn(args...)` and store its result, or the exception it throws.
+        template <typename F, typename... Args>
+        void setFrom(F &fn, Args &&...args)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    fn(std::forward<Args>(args)...);
+                    m_state->setValue();
+                }
+                else
+                {
+                    m_state->setValue(fn(std::forward<Args>(args)...));
+                }
+            }
+            catch (...)
+            {
+                m_state->setException(std::current_exception());
+            }
+        }
+
+    private:
+        detail::StateRef<T> m_state;
+    };
+
+    // Lightweight single-consumer future returned by RunLoop::post().
+    //
+    // Usage:
+    //   auto f = loop.post([] { return 42; });
+    //   int v = f.get();  // blocks until the loop has run the callable
+    //
+    //   loop.post([] { return 42; })
+    //       .then(uiLoop, [](int v) { /* runs on uiLoop */ });
+    template <typename T>
+    class Future
+    {
+    public:
+        Future() = default;
+        Future(Future &&) noexcept = default;
+        Future &operator=(Future &&) noexcept = default;
+        Future(const Future &) = delete;
+        Future &operator=(const Future &) = delete;
+
+        bool valid() const { return static_cast<bool>(m_state); }
+        bool isReady() const { return m_state->isReady(); }
+
+        void wait() const { m_state->wait(); }
+
+        template <typename Rep, typename Period>
+        bool waitFor(const std::chrono::duration<Rep, Period> &timeout) const
+        {
+            return m_state->waitFor(timeout);
+        }
+
+        // Block until ready, then return the value or rethrow the exception.
+        // Leaves the future invalid.
+        T get()
+        {
+            detail::StateRef<T> state = std::move(m_state);
+            state->wait();
+            if constexpr (std::is_void_v<T>)
+            {
+                state->take();
+            }
+            else
+            {
+                return state->take();
+            }
+        }
+
+        // Run `fn(value)` on `loop` once this future is ready and return a
+        // future for its result. The completing thread posts straight to
+        // `loop`, so the continuation costs a single hop no matter which
+        // loop produced the value; completed on `loop` itself, it runs as a
+        // microtask right after the completing handler. Exceptions skip
+        // `fn` and propagate. `fn` may be move-only. Leaves this future
+        // invalid.
+        template <typename Executor, typename F>
+        auto then(Executor &loop, F &&fn)
+            -> Future<typename detail::ContinuationResult<std::decay_t<F>, T>::type>
+        {
+            using R = typename detail::ContinuationResult<std::decay_t<F>, T>::type;
+
+            Promise<R> next;
+            Future<R> result = next.future();
+            detail::StateRef<T> state = std::move(m_state);
+            detail::FutureState<T> *raw = state.operator->();
+
+            raw->onReady([&loop, state, next, fn = detail::copyableCallable(std::forward<F>(fn))]() mutable {
+                loop.executeMicrotask([state, next, fn = std::move(fn)]() mutable {
+                    if (state->error())
+                    {
+                        next.setException(state->error());
+                    }
+                    else if constexpr (std::is_void_v<T>)
+                    {
+                        next.setFrom(fn);
+                    }
+                    else
+                    {
+                        next.setFrom(fn, state->take());
+                    }
+                });
+            });
+            return result;
+        }
+
+    private:
+        friend class Promise<T>;
+
+        explicit Future(detail::StateRef<T> state) : m_state(std::move(state)) {}
+
+        detail::StateRef<T> m_state;
+    };
+
+} // namespace ms
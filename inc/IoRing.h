@@ -0,0 +1,185 @@
+#pragma once
+
+#include "RunLoop.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ms
+{
+
+    // Completion-based file and pipe I/O for a run loop, on io_uring.
+    // Reads and writes go through a small set of registered buffers, so
+    // the kernel pins their pages once instead of on every operation, and
+    // optionally through registered files, which skips the per-operation
+    // fd lookup. Operations queued during an iteration are submitted with
+    // a single io_uring_enter just before the loop waits; completions
+    // arrive through an eventfd source and run on the loop thread.
+    //
+    // Everything except init() must be called on the loop thread. Destroy
+    // it on the loop thread, where its observer and source are removed at
+    // once (a completion may destroy its own ring), or after the loop has
+    // stopped.
+    //
+    // Usage:
+    //   ms::IoRing ring;
+    //   if (!ring.init(loop)) { /* no io_uring: fall back to read() */ }
+    //   int buffer = ring.acquireBuffer();
+    //   ring.readFixed(fd, buffer, ring.bufferSize(), 0, [&](int result) {
+    //       consume(ring.bufferData(buffer), result);
+    //       ring.releaseBuffer(buffer);
+    //   });
+    class IoRing
+    {
+    public:
+        struct Options
+        {
+            unsigned entries = 256;        // submission queue depth
+            unsigned bufferCount = 16;     // registered buffers
+            size_t bufferSize = 64 * 1024; // bytes per registered buffer
+            unsigned fileSlots = 64;       // registered file table size, 0 = none
+        };
+
+        struct Stats
+        {
+            uint64_t submitCalls = 0; // io_uring_enter calls that submitted
+            uint64_t submitted = 0;   // operations submitted
+            uint64_t completed = 0;   // completions delivered
+        };
+
+        // `result` is the number of bytes transferred, or -errno.
+        using Completion = std::function<void(int result)>;
+
+        // Offset meaning "the current file position"; required for pipes
+        // and sockets.
+        static constexpr uint64_t kCurrentPosition = ~uint64_t(0);
+
+        IoRing() = default;
+        ~IoRing();
+
+        IoRing(const IoRing &) = delete;
+        IoRing &operator=(const IoRing &) = delete;
+
+        // Create the ring, register its buffers and attach it to `loop`.
+        // Returns false when io_uring is unavailable (old kernel, seccomp,
+        // RLIMIT_MEMLOCK too low for the buffers); the ring is then unusable.
+        template <typename Loop>
+        bool init(Loop &loop);
+        template <typename Loop>
+        bool init(Loop &loop, const Options &options);
+
+        // Take a registered buffer, or -1 when all are in use. Buffers stay
+        // taken until released, so one can span several operations.
+        int acquireBuffer();
+        void releaseBuffer(int buffer);
+        char *bufferData(int buffer) const { return m_buffers + static_cast<size_t>(buffer) * m_bufferSize; }
+        size_t bufferSize() const { return m_bufferSize; }
+
+        // Put `fd` in the registered file table; later operations on it
+        // use the table slot. False when the table is full or absent.
+        bool registerFile(int fd);
+        void unregisterFile(int fd);
+
+        // Queue a read into (or a write from) the first `length` bytes of
+        // registered `buffer`. `done` runs on the loop thread once the
+        // kernel completes it. Returns false if `buffer` is not a valid
+        // index or the submission queue is full even after flushing it.
+        bool readFixed(int fd, int buffer, size_t length, uint64_t offset, Completion done);
+        bool writeFixed(int fd, int buffer, size_t length, uint64_t offset, Completion done);
+
+        // Hand queued operations to the kernel. Called by the loop before
+        // every wait; only needed directly to start I/O early.
+        void submit();
+
+        Stats stats() const { return m_stats; }
+
+    private:
+        bool setup(const Options &options);
+        bool prepare(uint8_t opcode, int fd, int buffer, size_t length, uint64_t offset, Completion done);
+        io_uring_sqe *nextSqe();
+        void reap();
+        void close();
+
+        int m_ringFd = -1;
+        int m_eventFd = -1;
+
+        // Shared ring memory.
+        void *m_sqRing = nullptr;
+        void *m_cqRing = nullptr;
+        size_t m_sqRingSize = 0;
+        size_t m_cqRingSize = 0;
+        io_uring_sqe *m_sqes = nullptr;
+        size_t m_sqesSize = 0;
+        unsigned *m_sqHead = nullptr;
+        unsigned *m_sqTail = nullptr;
+        unsigned *m_sqArray = nullptr;
+        unsigned m_sqMask = 0;
+        unsigned m_sqEntries = 0;
+        unsigned *m_cqHead = nullptr;
+        unsigned *m_cqTail = nullptr;
+        io_uring_cqe *m_cqes = nullptr;
+        unsigned m_cqMask = 0;
+
+        unsigned m_sqLocalTail = 0; // SQEs filled in, published on submit()
+        unsigned m_unsubmitted = 0;
+
+        char *m_buffers = nullptr;
+        size_t m_bufferSize = 0;
+        unsigned m_bufferCount = 0;
+        size_t m_buffersLength = 0;
+        std::vector<int> m_freeBuffers;
+
+        std::unordered_map<int, unsigned> m_fileSlots; // fd -> table slot
+        std::vector<unsigned> m_freeFileSlots;
+
+        // In-flight completions, indexed by the SQE's user_data.
+        std::vector<Completion> m_completions;
+        std::vector<uint32_t> m_freeCompletions;
+
+        Stats m_stats;
+
+        // Cancelled on destruction; tells reap() that a completion
+        // destroyed the ring under it.
+        CancelToken m_alive;
+
+        // Until the loop has run the submit observer once, a queued
+        // operation pokes the loop so it does not sleep on it.
+        bool m_observerActive = false;
+        std::function<void()> m_poke;
+        std::function<void()> m_detach;
+    };
+
+    template <typename Loop>
+    bool IoRing::init(Loop &loop)
+    {
+        return init(loop, Options());
+    }
+
+    template <typename Loop>
+    bool IoRing::init(Loop &loop, const Options &options)
+    {
+        if (!setup(options))
+        {
+            return false;
+        }
+
+        loop.addSource(m_eventFd, [this] { reap(); });
+        auto observer = loop.addObserver(Loop::Phase::BeforeWait, [this](uint64_t) {
+            m_observerActive = true;
+            submit();
+        });
+        m_poke = [&loop] { loop.executeOnRunLoop([] {}); };
+        m_detach = [&loop, fd = m_eventFd, observer] {
+            loop.removeObserver(observer);
+            loop.removeSource(fd);
+        };
+        return true;
+    }
+
+} // namespace ms
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "RunLoop.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace ms
+{
+
+    struct SpawnOptions
+    {
+        // Program and arguments; argv[0] is looked up in PATH.
+        std::vector<std::string> argv;
+
+        // "NAME=value" entries. Empty: inherit the parent's environment.
+        std::vector<std::string> env;
+
+        // Called on the loop thread with chunks of the child's output. A
+        // null callback leaves that stream attached to the parent's.
+        std::function<void(const char *data, size_t size)> onStdout;
+        std::function<void(const char *data, size_t size)> onStderr;
+
+        // Called once on the loop thread with the waitpid() status, after
+        // the child has exited and its captured output has been delivered.
+        // kStatusUnknown if the child was reaped by someone else (a stray
+        // waitpid(-1), or SIGCHLD set to SIG_IGN), so its status is lost.
+        std::function<void(int status)> onExit;
+
+        static constexpr int kStatusUnknown = -1;
+    };
+
+    namespace detail
+    {
+        struct SpawnedProcess
+        {
+            pid_t pid = -1;
+            int pidFd = -1;
+            int stdoutFd = -1; // read ends, non-blocking; -1 if not captured
+            int stderrFd = -1;
+        };
+
+        // posix_spawnp() plus pidfd_open(). Returns pid -1 with errno set
+        // on failure, with nothing left behind.
+        SpawnedProcess startProcess(const SpawnOptions &options);
+
+        // Reaps an exited child without blocking. False if still running;
+        // status kStatusUnknown if it was already reaped elsewhere.
+        bool reapProcess(pid_t pid, int &status);
+
+        void closeFd(int fd);
+
+        // Shared by the three handlers of one child; loop-thread only.
+        struct ProcessState
+        {
+            SpawnedProcess process;
+            std::function<void(int)> onExit;
+            int openStreams = 0;
+            bool exited = false;
+            int status = 0;
+
+            void finishIfDone()
+            {
+                if (exited && openStreams == 0 && onExit)
+                {
+                    auto onExitNow = std::move(onExit);
+                    onExit = nullptr;
+                    onExitNow(status);
+                }
+            }
+        };
+    } // namespace detail
+
+    // Start a child process driven entirely by `loop`: no SIGCHLD handler,
+    // reaper thread or waitpid() polling. Exit is noticed through a pidfd
+    // registered as a source; captured stdout/stderr pipes are read-mode
+    // sources, so idle children hold no read buffer. The child starts with
+    // no signals blocked and default dispositions, whatever the spawning
+    // thread has (addSignal() blocks its signals on the loop thread).
+    // Returns the child's pid, or -1 with errno set if it could not be
+    // started. Needs Linux 5.3+ (pidfd_open). Thread-safe, like
+    // addSource().
+    //
+    // Usage:
+    //   ms::SpawnOptions options;
+    //   options.argv = {"ls", "-l"};
+    //   options.onStdout = [](const char *data, size_t size) { ... };
+    //   options.onExit = [](int status) { ... WEXITSTATUS(status) ... };
+    //   ms::spawnProcess(loop, std::move(options));
+    template <typename Loop>
+    pid_t spawnProcess(Loop &loop, SpawnOptions options)
+    {
+        detail::SpawnedProcess process = detail::startProcess(options);
+        if (process.pid < 0)
+        {
+            return -1;
+        }
+
+        auto state = std::make_shared<detail::ProcessState>();
+        state->process = process;
+        state->onExit = std::move(options.onExit);
+        // Counted up front: off the loop thread, a stream may end before
+        // the next one is registered.
+        state->openStreams = (process.stdoutFd >= 0 ? 1 : 0) + (process.stderrFd >= 0 ? 1 : 0);
+
+        auto capture = [&loop, state](int fd, std::function<void(const char *, size_t)> sink) {
+            if (fd < 0)
+            {
+                return;
+            }
+            loop.addReadSource(fd, [&loop, state, fd, sink = std::move(sink)](const char *data, ssize_t n) {
+                if (n > 0)
+                {
+                    sink(data, static_cast<size_t>(n));
+                    return;
+                }
+                // EOF or error: the stream is done.
+                loop.removeSource(fd);
+                detail::closeFd(fd);
+                --state->openStreams;
+                state->finishIfDone();
+            });
+        };
+        capture(process.stdoutFd, std::move(options.onStdout));
+        capture(process.stderrFd, std::move(options.onStderr));
+
+        loop.addSource(process.pidFd, [&loop, state] {
+            int status = 0;
+            if (!detail::reapProcess(state->process.pid, status))
+            {
+                return;
+            }
+            loop.removeSource(state->process.pidFd);
+            detail::closeFd(state->process.pidFd);
+            state->exited = true;
+            state->status = status;
+            state->finishIfDone();
+        });
+        return process.pid;
+    }
+
+} // namespace ms
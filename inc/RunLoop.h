@@ -1,25 +1,66 @@
 #pragma once
 
+#include "CancelToken.h"
+#include "Future.h"
+
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <sys/types.h>
+
+struct epoll_event;
+
 namespace ms
 {
 
-    // Pure event loop. Runs on a dedicated thread, allows other
-    // components to post work to that thread. No transport knowledge.
+    namespace detail
+    {
+        // Lock that does nothing, for loops that are never shared.
+        struct NullMutex
+        {
+            void lock() {}
+            void unlock() {}
+            bool try_lock() { return true; }
+        };
+    } // namespace detail
+
+    // Threading policies for BasicRunLoop.
     //
-    // Usage:
-    //   RunLoop loop;
-    //   loop.init("MyApp");
-    //   loop.executeOnRunLoop([&] { /* runs on loop thread */ });
-    //   loop.run();  // blocks until stop()
+    // ThreadSafePolicy: any thread may post, schedule timers and register
+    // sources; cross-thread calls wake the loop through a pipe.
+    //
+    // SingleThreadPolicy: everything happens on the thread that calls
+    // run() — from handlers, or before run() starts. All locks compile to
+    // nothing and there is no wakeup pipe. Only stats() may be called from
+    // another thread.
+    struct ThreadSafePolicy
+    {
+        using Mutex = std::mutex;
+        static constexpr bool kThreadSafe = true;
+    };
+
+    struct SingleThreadPolicy
+    {
+        using Mutex = detail::NullMutex;
+        static constexpr bool kThreadSafe = false;
+    };
 
-    class RunLoop
+    // Types shared by every BasicRunLoop instantiation, so that
+    // RunLoop::Priority and LocalRunLoop::Priority are the same type.
+    class RunLoopBase
     {
     public:
         struct Version
@@ -30,15 +71,156 @@ namespace ms
             static constexpr uint32_t packed = (major << 16) | (minor << 8) | patch;
         };
 
-        RunLoop();
-        ~RunLoop();
+        // Posting lanes. Each iteration drains High first, then Normal,
+        // then Low. High is always drained completely; Normal and Low share
+        // Options::postBudget but each is guaranteed Options::minLaneQuota
+        // callables per iteration so a busy lane above cannot starve it.
+        enum class Priority : uint8_t
+        {
+            High = 0,
+            Normal = 1,
+            Low = 2,
+        };
+        static constexpr size_t kPriorityCount = 3;
+
+        // How precisely timers are waited for.
+        enum class TimerResolution : uint8_t
+        {
+            Millisecond, // epoll_wait timeout, rounded up to whole milliseconds
+            High,        // EpollPwait2 when the kernel has it, else TimerFd
+            EpollPwait2, // nanosecond epoll_pwait2 timeout (Linux 5.11+); still
+                         // subject to the thread's timer slack (50 µs default)
+            TimerFd,     // one timerfd per loop, armed to the earliest deadline
+        };
+
+        struct Options
+        {
+            // Maximum number of Normal + Low callables executed per iteration.
+            // Leftovers run on the next iteration, after fd events have been
+            // polled and newly posted High work has run. 0 = unlimited.
+            size_t postBudget = 0;
+
+            // Callables each lower lane may run per iteration even when the
+            // lanes above have used up the budget.
+            size_t minLaneQuota = 16;
+
+            // Use High for sub-millisecond timers (e.g. 100 µs control loops).
+            TimerResolution timerResolution = TimerResolution::Millisecond;
+
+            // Events fetched per epoll_wait. With maxEventBatch above
+            // eventBatch the batch adapts between the two: it doubles when a
+            // wait comes back full and halves after a run of sparse waits.
+            size_t eventBatch = 32;
+            size_t maxEventBatch = 0; // 0 = fixed at eventBatch
+
+            // For pure work-queue loops: while no fd is registered, block on
+            // a futex instead of epoll_wait, so producers wake the loop with
+            // FUTEX_WAKE rather than a pipe write and the loop needs no
+            // drain read. The loop goes back to epoll as soon as a source or
+            // fd wait is added. Ignored by LocalRunLoop.
+            bool parkOnFutex = false;
+
+            // Size of the pooled buffers read-mode sources are read into;
+            // at least 1 (0 is raised to 1).
+            size_t readBufferSize = 16 * 1024;
+        };
+
+        struct LaneStats
+        {
+            uint64_t posted = 0;   // callables queued on this lane
+            uint64_t executed = 0; // callables dequeued for execution
+            uint64_t deferred = 0; // iterations that left work in this lane
+            uint64_t cancelled = 0; // callables skipped because their token was cancelled
+        };
+
+        struct Stats
+        {
+            LaneStats lanes[kPriorityCount];
+            uint64_t timersFired = 0;  // timer callbacks invoked
+            uint64_t timerWakeups = 0; // iterations that fired at least one timer
+            uint64_t idleExecuted = 0; // executeWhenIdle() callables run
+            uint64_t idleOverdue = 0;  // ... of which ran in a busy iteration past their deadline
+            uint64_t microtasksExecuted = 0;
+            uint64_t eventWaits = 0;     // waits that returned at least one event
+            uint64_t eventsReceived = 0; // events returned by those waits
+            uint64_t fullBatches = 0;    // ... of which filled the whole batch
+            uint64_t eventBatch = 0;     // current batch size
+            uint64_t futexParks = 0;     // waits spent parked on the futex
+            uint64_t pooledReads = 0;    // reads done for read-mode sources
+            uint64_t readBuffers = 0;    // pooled read buffers allocated
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        // Identifies a pending timer. 0 is never a valid id.
+        using TimerId = uint64_t;
+
+        // What a periodic timer does after the loop fell behind by more
+        // than one interval.
+        enum class MissedTicks : uint8_t
+        {
+            Skip,    // fire once, then continue on the original phase
+            CatchUp, // fire once for every interval that was missed
+        };
+
+        struct TimerOptions
+        {
+            // How late the timer may fire. The loop wakes at the earliest
+            // window end (deadline + slack) and fires timers in order of
+            // window end while their windows have opened, stopping at the
+            // first that has not. Timers with overlapping windows therefore
+            // mostly, but not always, share a wakeup.
+            std::chrono::nanoseconds slack{0};
+            MissedTicks missedTicks = MissedTicks::Skip;
+        };
+
+        // Points in each loop iteration where observers run, in order.
+        enum class Phase : uint8_t
+        {
+            BeforePosts,   // start of the iteration, before posted callables
+            BeforeWait,    // after posted callables, before epoll_wait
+            AfterHandlers, // after fd handlers, timers and idle callables
+        };
+        static constexpr size_t kPhaseCount = 3;
 
-        RunLoop(const RunLoop &) = delete;
-        RunLoop &operator=(const RunLoop &) = delete;
+        // Identifies an observer. 0 is never a valid id.
+        using ObserverId = uint64_t;
+
+        // Identifies a file watch: the inotify watch descriptor.
+        using WatchId = int;
+
+        // Called with the IN_* bits seen and, for a directory watch, the
+        // name of the entry they concern ("" for the watched path itself).
+        using WatchHandler = std::function<void(uint32_t events, const std::string &name)>;
+
+        static constexpr uint32_t kMaxDispatchDepth = 16;
+    };
+
+    // Pure event loop. Runs on a dedicated thread, allows other
+    // components to post work to that thread. No transport knowledge.
+    // Use it through the RunLoop (thread-safe) and LocalRunLoop
+    // (single-threaded, lock-free) aliases below.
+    //
+    // Usage:
+    //   RunLoop loop;
+    //   loop.init("MyApp");
+    //   loop.executeOnRunLoop([&] { /* runs on loop thread */ });
+    //   loop.run();  // blocks until stop()
+
+    template <typename Policy>
+    class BasicRunLoop : public RunLoopBase
+    {
+    public:
+        BasicRunLoop();
+        ~BasicRunLoop();
+
+        BasicRunLoop(const BasicRunLoop &) = delete;
+        BasicRunLoop &operator=(const BasicRunLoop &) = delete;
 
         // Initialize the run loop. `name` identifies this loop
         // for debugging/logging purposes.
         void init(const char *name);
+        void init(const char *name, const Options &options);
 
         // Block the calling thread, dispatching events until stop() is called.
         void run();
@@ -48,35 +230,609 @@ namespace ms
         void stop();
 
         // Post a callable to be executed on the run loop thread.
+        // Callables on the same lane run in FIFO order.
         // Thread-safe — can be called from any thread.
-        void executeOnRunLoop(std::function<void()> fn);
+        void executeOnRunLoop(std::function<void()> fn, Priority priority = Priority::Normal);
 
-        // Watch a file descriptor for readability. When data is available,
-        // `handler` is called on the run loop thread.
+        // As above, but `fn` is skipped if `token` is cancelled before the
+        // loop reaches it. Thread-safe.
+        void executeOnRunLoop(std::function<void()> fn, CancelToken token,
+                              Priority priority = Priority::Normal);
+
+        // Post a callable and return a token that cancels it. Thread-safe.
+        CancelToken executeCancellable(std::function<void()> fn, Priority priority = Priority::Normal);
+
+        // Post a callable and get a Future for its return value (or the
+        // exception it throws). Thread-safe.
+        template <typename F>
+        auto post(F &&fn, Priority priority = Priority::Normal)
+            -> Future<std::invoke_result_t<std::decay_t<F> &>>;
+
+        // Run `fn` on the loop thread, block until it finishes and return
+        // its result. When called on the loop thread itself, `fn` runs
+        // inline instead of deadlocking on its own queue.
+        template <typename F>
+        auto executeAndWait(F &&fn) -> std::invoke_result_t<std::decay_t<F> &>;
+
+        // Run `fn` inline when called on the loop thread, otherwise post it
+        // like executeOnRunLoop(). Inline calls nest at most
+        // kMaxDispatchDepth deep; beyond that `fn` is posted so a chain of
+        // dispatches cannot overflow the stack.
+        template <typename F>
+        void dispatch(F &&fn, Priority priority = Priority::Normal);
+
+        // Queue `fn` to run right after the current handler returns — after
+        // the posted callable, fd handler, timer or idle callable that is
+        // running now, before anything else and before the loop waits
+        // again. Microtasks queued by microtasks run in the same drain.
+        // Loop-thread only and lock-free; from any other thread this falls
+        // back to executeOnRunLoop().
+        void executeMicrotask(std::function<void()> fn);
+
+        // Run `fn` on the loop thread in an idle iteration: one in which no
+        // posted callable ran, no fd was ready and no timer fired. With
+        // `maxDeferral`, `fn` runs in the first iteration after that much
+        // time has passed even if the loop never goes idle.
         // Thread-safe — can be called from any thread.
+        void executeWhenIdle(std::function<void()> fn);
+        void executeWhenIdle(std::function<void()> fn, std::chrono::nanoseconds maxDeferral);
+
+        // Run `fn` on the loop thread once `delay` has elapsed.
+        // Thread-safe — can be called from any thread.
+        TimerId executeAfter(std::chrono::nanoseconds delay, std::function<void()> fn);
+
+        // As above, but the timer does not fire once `token` is cancelled.
+        TimerId executeAfter(std::chrono::nanoseconds delay, std::function<void()> fn,
+                             CancelToken token);
+
+        // Run `fn` on the loop thread every `interval`, first after one
+        // interval, until cancelTimer(). Give housekeeping ticks some slack
+        // so that many of them share a wakeup. Thread-safe.
+        TimerId executeEvery(std::chrono::nanoseconds interval, std::function<void()> fn);
+        TimerId executeEvery(std::chrono::nanoseconds interval, std::function<void()> fn,
+                             const TimerOptions &options);
+
+        // Cancel a pending (or periodic) timer. Returns false if it already
+        // fired or was cancelled. O(1). Thread-safe.
+        bool cancelTimer(TimerId id);
+
+        // Call `fn(iteration)` on the loop thread at `phase` of every
+        // iteration, e.g. to flush output buffered by many handlers with one
+        // writev per turn. Adding takes effect from the next iteration.
+        // Removing on the loop thread takes effect at once, even for the
+        // phase in progress, so the owner may free what `fn` refers to as
+        // soon as removeObserver() returns; from another thread `fn` may
+        // still run during the current iteration. Thread-safe.
+        ObserverId addObserver(Phase phase, std::function<void(uint64_t)> fn);
+        bool removeObserver(ObserverId id);
+
+        // Number of loop iterations started so far. Thread-safe.
+        uint64_t iteration() const { return m_iteration.load(std::memory_order_relaxed); }
+
+        // Watch a file descriptor for readability. When data is available,
+        // `handler` is called on the run loop thread. On the loop thread
+        // this takes effect at once; from any other thread the change is
+        // queued and applied by the loop before its next wait, with
+        // add/replace/remove sequences for one fd collapsed into a single
+        // epoll_ctl. Thread-safe.
         void addSource(int fd, std::function<void()> handler);
 
-        // Stop watching a file descriptor. Thread-safe.
+        // Register many sources with one queue hand-off and one wakeup.
+        // Thread-safe.
+        void addSources(std::vector<std::pair<int, std::function<void()>>> sources);
+
+        // As above, with a handler object owned by the caller: `(*handler)()`
+        // runs on readability. The concrete type is kept, so dispatch is a
+        // plain call through a per-type trampoline that the compiler can
+        // inline the handler into, instead of an indirect call through
+        // std::function's type erasure. Class types only; functions take
+        // the std::function overload. `handler` must outlive the
+        // registration. Thread-safe.
+        template <typename Handler, typename = std::enable_if_t<std::is_class_v<Handler>>>
+        void addSource(int fd, Handler *handler);
+
+        // As addSource(), for an fd that several loops watch at once (a
+        // shared listening socket, an eventfd used as a work signal). The
+        // fd is registered with EPOLLEXCLUSIVE, so an event wakes one of
+        // the loops blocked on it rather than all of them; loops that are
+        // busy when the event arrives may still see it on their next wait,
+        // so handlers must cope with finding nothing to do (EAGAIN).
+        // Thread-safe.
+        void addSharedSource(int fd, std::function<void()> handler);
+
+        // Called with the outcome of a read done by the loop: `result` bytes
+        // at `data` (> 0), end of file (0) or -errno. `data` belongs to the
+        // loop and is only valid for the duration of the call.
+        using ReadHandler = std::function<void(const char *data, ssize_t result)>;
+
+        // Read-mode source: on readability the loop itself reads up to
+        // Options::readBufferSize bytes into a buffer from a per-loop pool,
+        // hands it to `handler` and takes it back afterwards. Idle fds hold
+        // no buffer at all, and the few buffers in use are reused while
+        // still hot in cache. One read per readiness; anything left is
+        // reported on the next iteration. Otherwise behaves like
+        // addSource() (remove, pause and resume apply). Thread-safe.
+        void addReadSource(int fd, ReadHandler handler);
+
+        // Stop watching a file descriptor. The handler is not called again,
+        // even for an event already in the current batch. From another
+        // thread the removal is queued like addSource(), and the call waits
+        // until a running loop has applied it, so the fd may be closed (and
+        // its number reused) as soon as it returns. With the loop stopped it
+        // returns at once; the removal is then applied before anything else
+        // when the loop next runs. Thread-safe.
         void removeSource(int fd);
 
+        // Stop and restart dispatching a source without unregistering it,
+        // for backpressure: the fd and handler stay in place. Pausing only
+        // sets a flag; the fd's epoll interest is dropped the first time
+        // it turns out to be ready while paused, and restored on resume.
+        // A pause that ends before the fd becomes ready therefore costs no
+        // syscall, and a busy pause/resume cycle at most two. Data that
+        // arrived while paused is reported right after resume (sources are
+        // level-triggered). Off the loop thread both calls are queued like
+        // addSource(). Unknown fds are ignored. Thread-safe.
+        void pauseSource(int fd);
+        void resumeSource(int fd);
+
+        // Also report writability of source `fd`: `handler` runs on the
+        // loop thread whenever the fd is writable (level-triggered, like
+        // readability, and also on EPOLLERR/EPOLLHUP) until cleared with
+        // nullptr. Meant for flushing output that a non-blocking write did
+        // not take in full, so set it only while output is pending. Not
+        // affected by pauseSource(); replacing or removing the source
+        // clears it. Unknown fds are ignored. Loop-thread only.
+        void setSourceWritable(int fd, std::function<void()> handler);
+
+        // Call `fn` once on the loop thread when `fd` becomes readable
+        // (or writable). One-shot: wait again for the next event. Between
+        // waits the fd stays registered but disarmed, so re-arming costs a
+        // single epoll_ctl and no allocation — cheap enough to use per
+        // read/write. A read and a write wait may be pending at once.
+        // An fd is either a source or waited on, never both.
+        // Thread-safe — can be called from any thread.
+        void waitReadable(int fd, std::function<void()> fn);
+        void waitWritable(int fd, std::function<void()> fn);
+
+        // Drop pending waits on `fd` and unregister it. Call before
+        // closing an fd that has been waited on. Thread-safe.
+        void cancelWaits(int fd);
+
+        // Call `handler(signo)` on the loop thread when `signo` arrives. The
+        // signal is read from a signalfd instead of interrupting a thread,
+        // so the handler is an ordinary callback with no async-signal-safety
+        // limits. The signal gets blocked in the calling thread and in the
+        // loop thread; block it in every other thread as well (simplest:
+        // in main() before starting any) or the kernel may still deliver it
+        // the default way. Deliveries that pile up before the loop reads
+        // them run the handler once. Adding a signal again replaces its
+        // handler. Thread-safe.
+        void addSignal(int signo, std::function<void(int)> handler);
+
+        // Stop handling `signo`. It stays blocked, so later deliveries
+        // remain pending. Thread-safe.
+        void removeSignal(int signo);
+
+        // Watch `path` for the inotify `events` (IN_MODIFY, IN_CREATE, ...).
+        // All watches of a loop share one inotify fd. Events queued for
+        // the same file between two iterations are merged into one call
+        // with their bits OR-ed, so a burst of writes costs one callback.
+        // Watching a path again replaces its handler and events; events
+        // that arrive before the loop has installed the handler are
+        // dropped. IN_IGNORED (file deleted, file system unmounted) is
+        // delivered and ends the watch; removeWatch() ends it silently.
+        // Returns -1 with errno set on failure. Thread-safe.
+        WatchId addWatch(const std::string &path, uint32_t events, WatchHandler handler);
+        void removeWatch(WatchId id);
+
         bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+        // True when called from the thread currently inside run(). Always
+        // true for a single-threaded loop, which has no other thread.
+        bool isOnLoopThread() const
+        {
+            if constexpr (!Policy::kThreadSafe)
+            {
+                return true;
+            }
+            return m_loopThread.load(std::memory_order_acquire) == std::this_thread::get_id();
+        }
+
         const char *name() const { return m_name; }
 
+        // Snapshot of the per-lane counters. Thread-safe.
+        Stats stats() const;
+
+        // Timer backend chosen by init(): Millisecond, EpollPwait2 or TimerFd.
+        TimerResolution timerResolution() const { return m_timerBackend; }
+
     private:
+        using Mutex = typename Policy::Mutex;
+
+        // Interrupts epoll_wait. On the loop thread it only makes the next
+        // wait a poll: the loop is awake already, no syscall needed.
         void wakeup();
 
+        void drainMicrotasks()
+        {
+            if (!m_microtasks.empty())
+            {
+                runMicrotasks();
+            }
+        }
+        void runMicrotasks();
+
+        void notifyObservers(Phase phase, uint64_t iteration);
+
+        // Runs one budgeted batch of posted callables and returns how many
+        // ran. Sets `more` if work was left queued for the next iteration.
+        size_t runPostedBatch(bool &more);
+
+        void initTimerBackend();
+
+        // When the loop must wake for the earliest timer, or time_point::max().
+        Clock::time_point nextTimerDeadline();
+
+        // epoll_wait (or epoll_pwait2) until an fd is ready or the next
+        // timer is due. `poll` = return immediately.
+        int waitForEvents(struct epoll_event *events, int maxEvents, bool poll);
+
+        void armTimerFd(Clock::time_point deadline);
+
+        // Options::parkOnFutex: publishes that the loop is about to block,
+        // then parks on the futex (no fds registered) or falls through to
+        // waitForEvents(). Either way it rechecks for work first, so a
+        // producer that saw the loop running may skip the wakeup entirely.
+        int waitOrPark(struct epoll_event *events, int maxEvents, bool poll);
+        bool hasPendingWork(bool parking);
+
+        // FUTEX_WAKE if the loop is parked; no-op otherwise.
+        void wakeParked();
+
+        // Runs every timer whose deadline has passed. True if any fired.
+        bool runDueTimers();
+
+        struct IdleTask
+        {
+            std::function<void()> fn;
+            Clock::time_point deadline; // max() = no deadline
+        };
+
+        void enqueueIdle(IdleTask task);
+
+        // `idle`: run everything queued; otherwise only overdue tasks.
+        void runIdleTasks(bool idle);
+
+        struct IoWait
+        {
+            std::function<void()> onReadable;
+            std::function<void()> onWritable;
+            bool registered = false; // fd is in the epoll set (possibly disarmed)
+        };
+
+        // (Re-)enables the one-shot registration. Needs m_sourcesMutex.
+        void armIoWait(int fd, IoWait &wait);
+
+        // Hands ready waiters their event and re-arms the rest.
+        void dispatchIoWait(int fd, uint32_t events);
+
         const char *m_name = "";
+        Options m_options;
         int m_epollFd = -1;
         int m_wakeupFd[2] = {-1, -1};
 
+        // Loop-thread only. One signalfd covers every handled signal.
+        int m_signalFd = -1;
+        std::unordered_map<int, std::function<void(int)>> m_signalHandlers;
+        void updateSignalFd();
+        void dispatchSignals();
+
+        // Created on first use, under m_sourcesMutex.
+        int m_inotifyFd = -1;
+        std::unordered_map<int, WatchHandler> m_watchHandlers; // loop-thread only
+        struct WatchEvent
+        {
+            int wd;
+            uint32_t events;
+            std::string name;
+        };
+        std::vector<WatchEvent> m_watchEvents; // reused per read
+        void dispatchWatches(int fd);
+
+        TimerResolution m_timerBackend = TimerResolution::Millisecond;
+        int m_timerFd = -1;
+        Clock::time_point m_timerFdDeadline = Clock::time_point::min(); // loop-thread only
+
         std::atomic<bool> m_running{false};
         std::atomic<bool> m_stopRequested{false};
+        std::atomic<std::thread::id> m_loopThread{};
+
+        // Loop-thread only.
+        bool m_wakeupPending = false;
+        uint32_t m_dispatchDepth = 0;
+        std::vector<std::function<void()>> m_microtasks;
+        std::vector<std::function<void()>> m_runningMicrotasks;
+        std::atomic<uint64_t> m_microtasksExecuted{0};
+
+        // Adapts the epoll batch after a wait that returned `n` events.
+        void adaptEventBatch(int n);
+
+        std::atomic<size_t> m_eventBatch{0}; // written by the loop thread only
+        size_t m_sparseWaits = 0;             // loop-thread only
+        std::atomic<uint64_t> m_eventWaits{0};
+        std::atomic<uint64_t> m_eventsReceived{0};
+        std::atomic<uint64_t> m_fullBatches{0};
+
+        // Options::parkOnFutex state.
+        enum WaitState : uint32_t
+        {
+            kRunning,
+            kParked,  // blocked on m_futexWord
+            kInEpoll, // blocked in epoll_wait; woken through the pipe
+        };
+        std::atomic<uint32_t> m_waitState{kRunning};
+        std::atomic<uint32_t> m_futexWord{0}; // bumped to wake a parked loop
+        std::atomic<size_t> m_fdCount{0};     // sources + fd waits
+        std::atomic<uint64_t> m_futexParks{0};
+
+        struct Observer
+        {
+            ObserverId id;
+            Phase phase;
+            std::function<void(uint64_t)> fn;
+        };
+
+        std::atomic<uint64_t> m_iteration{0};
+        Mutex m_observerMutex;
+        std::vector<Observer> m_observers; // guarded by m_observerMutex
+        ObserverId m_nextObserverId = 1;   // guarded by m_observerMutex
+        std::atomic<bool> m_observersChanged{false};
+
+        // Loop-thread only: snapshot of m_observers, split by phase. An
+        // entry removed on the loop thread gets id 0 and is skipped until
+        // the next rebuild.
+        struct PhaseObserver
+        {
+            ObserverId id;
+            std::function<void(uint64_t)> fn;
+        };
+        std::vector<PhaseObserver> m_phaseObservers[kPhaseCount];
+
+        struct LaneCounters
+        {
+            std::atomic<uint64_t> posted{0};
+            std::atomic<uint64_t> executed{0};
+            std::atomic<uint64_t> deferred{0};
+            std::atomic<uint64_t> cancelled{0};
+        };
+
+        // A queued callable and its cancellation flag (null if not cancellable).
+        struct PostedTask
+        {
+            std::function<void()> fn;
+            std::shared_ptr<std::atomic<bool>> cancelled;
+        };
+
+        void enqueue(PostedTask task, Priority priority);
+        TimerId scheduleTimer(std::chrono::nanoseconds delay, std::chrono::nanoseconds interval,
+                              const TimerOptions &options, PostedTask task);
 
-        std::mutex m_postMutex;
-        std::vector<std::function<void()>> m_postQueue;
+        // Frees a timer slot and invalidates its id. Needs m_timerMutex.
+        void releaseTimerSlot(uint32_t slot);
+        bool isTimerActive(uint32_t slot, uint32_t generation);
 
-        std::mutex m_sourcesMutex;
-        std::unordered_map<int, std::function<void()>> m_sources;
+        Mutex m_postMutex;
+        std::vector<PostedTask> m_postQueues[kPriorityCount];
+
+        std::vector<IdleTask> m_idleQueue; // guarded by m_postMutex
+
+        // Loop-thread only: callables that did not fit in an iteration's budget.
+        std::deque<PostedTask> m_deferredPosts[kPriorityCount];
+
+        // Loop-thread only: idle tasks waiting for a quiet iteration.
+        std::deque<IdleTask> m_idleTasks;
+        Clock::time_point m_nextIdleDeadline = Clock::time_point::max();
+        std::atomic<uint64_t> m_idleExecuted{0};
+        std::atomic<uint64_t> m_idleOverdue{0};
+        LaneCounters m_laneCounters[kPriorityCount];
+
+        // Timers live in a slot table so that scheduling and cancelling
+        // reuse storage instead of allocating per timer. A TimerId is
+        // (generation << 32 | slot); heap entries whose generation no
+        // longer matches their slot are stale and skipped.
+        struct TimerSlot
+        {
+            std::function<void()> fn;
+            std::shared_ptr<std::atomic<bool>> cancelled;
+            std::chrono::nanoseconds interval{0}; // 0 = one-shot
+            std::chrono::nanoseconds slack{0};
+            MissedTicks missedTicks = MissedTicks::Skip;
+            uint32_t generation = 1;
+            bool active = false;
+        };
+
+        struct TimerEntry
+        {
+            Clock::time_point deadline; // earliest firing time
+            Clock::time_point latest;   // deadline + slack
+            uint32_t slot;
+            uint32_t generation;
+        };
+
+        // A timer being fired this iteration. Periodic callables are
+        // handed back to their slot afterwards.
+        struct DueTimer
+        {
+            PostedTask task;
+            uint32_t slot;
+            uint32_t generation;
+            uint64_t ticks;
+            bool periodic;
+        };
+
+        // Min-heap order on the latest firing time.
+        static bool laterDeadline(const TimerEntry &a, const TimerEntry &b)
+        {
+            return a.latest > b.latest;
+        }
+
+        Mutex m_timerMutex;
+        std::vector<TimerSlot> m_timerSlots;
+        std::vector<uint32_t> m_freeTimerSlots;
+        std::vector<TimerEntry> m_timerHeap;
+
+        // Loop-thread only: timers collected for the current iteration.
+        std::vector<DueTimer> m_dueTimers;
+        std::atomic<uint64_t> m_timersFired{0};
+        std::atomic<uint64_t> m_timerWakeups{0};
+
+        // Either a type-erased handler or a typed object plus trampoline.
+        struct Source
+        {
+            std::function<void()> fn;
+            void (*invoke)(void *) = nullptr;
+            void *object = nullptr;
+            ReadHandler onRead; // read-mode source
+            std::function<void()> onWritable; // set: EPOLLOUT interest
+            bool exclusive = false; // EPOLLEXCLUSIVE: shared with other loops
+            bool paused = false;
+            bool armed = true; // epoll interest includes EPOLLIN
+        };
+
+        enum class SourceOp : uint8_t
+        {
+            Set, // add or replace
+            Remove,
+            Pause,
+            Resume,
+        };
+
+        // A change requested off the loop thread. `source` is only set
+        // for SourceOp::Set.
+        struct SourceCommand
+        {
+            int fd;
+            SourceOp op;
+            std::unique_ptr<Source> source;
+        };
+
+        // Adds or replaces (`source` set) or removes a source. Applied at
+        // once on the loop thread, otherwise queued for it.
+        void changeSource(int fd, std::unique_ptr<Source> source);
+        // Both return a ticket for waitForSourceCommands().
+        uint64_t queueSourceCommands(std::vector<SourceCommand> commands);
+        uint64_t queueSourceCommand(int fd, SourceOp op, std::unique_ptr<Source> source = nullptr);
+        // Blocks until the loop has applied the commands up to `ticket`, or
+        // is not running.
+        void waitForSourceCommands(uint64_t ticket);
+
+        // Loop-thread only. `removed`: the fd was removed earlier in the
+        // same batch, so its number may now name a different file.
+        void applySourceChange(int fd, std::unique_ptr<Source> source, bool removed);
+
+        // Loop-thread only. Pausing is lazy; see pauseSource().
+        void applySourcePause(int fd, bool paused);
+        void setSourceInterest(int fd, Source &source, bool armed);
+        // Brings the registration from interest `before` to the current
+        // one; an fd with no interest left is unregistered.
+        void updateSourceInterest(int fd, Source &source, uint32_t before);
+        static uint32_t sourceInterest(const Source &source);
+
+        // Reads into a pooled buffer and calls source.onRead.
+        void dispatchReadSource(int fd, Source &source);
+
+        // Loop-thread only. Applies queued commands, collapsing all of
+        // them for one fd into at most one epoll_ctl.
+        void applySourceCommands();
+
+        Mutex m_sourcesMutex; // guards m_sourceCommands, m_ioWaits and m_inotifyFd creation
+        std::vector<SourceCommand> m_sourceCommands;
+        std::atomic<bool> m_sourceCommandsPending{false};
+        uint64_t m_sourceCommandsQueued = 0;  // tickets handed out, under m_sourcesMutex
+        uint64_t m_sourceCommandsApplied = 0; // ... and applied, under m_sourcesMutex
+        std::condition_variable_any m_sourceCommandsDone;
+        std::unordered_map<int, IoWait> m_ioWaits;
+
+        // Loop-thread only: dispatch looks sources up without locking.
+        // Sources are boxed so a handler that removes itself keeps running
+        // from a live object; removed sources are retired and freed after
+        // the event batch.
+        std::unordered_map<int, std::unique_ptr<Source>> m_sources;
+        std::vector<std::unique_ptr<Source>> m_retiredSources;
+
+        struct PendingSource
+        {
+            std::unique_ptr<Source> source;
+            bool set = false;
+            bool removed = false;
+            bool pauseChanged = false;
+            bool paused = false;
+        };
+        std::unordered_map<int, PendingSource> m_pendingSources; // reused per batch
+
+        // Loop-thread only. Free read buffers, most recently used last.
+        std::vector<std::unique_ptr<char[]>> m_readBuffers;
+        std::atomic<uint64_t> m_pooledReads{0};
+        std::atomic<uint64_t> m_readBuffersAllocated{0};
     };
 
+    using RunLoop = BasicRunLoop<ThreadSafePolicy>;
+    using LocalRunLoop = BasicRunLoop<SingleThreadPolicy>;
+
+    // Both are instantiated once, in RunLoop.cpp.
+    extern template class BasicRunLoop<ThreadSafePolicy>;
+    extern template class BasicRunLoop<SingleThreadPolicy>;
+
+    template <typename Policy>
+    template <typename F>
+    auto BasicRunLoop<Policy>::post(F &&fn, Priority priority)
+        -> Future<std::invoke_result_t<std::decay_t<F> &>>
+    {
+        using R = std::invoke_result_t<std::decay_t<F> &>;
+
+        Promise<R> promise;
+        Future<R> future = promise.future();
+        executeOnRunLoop([promise, fn = std::forward<F>(fn)]() mutable { promise.setFrom(fn); },
+                         priority);
+        return future;
+    }
+
+    template <typename Policy>
+    template <typename F>
+    auto BasicRunLoop<Policy>::executeAndWait(F &&fn) -> std::invoke_result_t<std::decay_t<F> &>
+    {
+        if (isOnLoopThread())
+        {
+            return fn();
+        }
+        return post(std::forward<F>(fn)).get();
+    }
+
+    template <typename Policy>
+    template <typename Handler, typename>
+    void BasicRunLoop<Policy>::addSource(int fd, Handler *handler)
+    {
+        auto source = std::make_unique<Source>();
+        source->invoke = [](void *object) { (*static_cast<Handler *>(object))(); };
+        source->object = const_cast<void *>(static_cast<const void *>(handler));
+        changeSource(fd, std::move(source));
+    }
+
+    template <typename Policy>
+    template <typename F>
+    void BasicRunLoop<Policy>::dispatch(F &&fn, Priority priority)
+    {
+        if (isOnLoopThread() && m_dispatchDepth < kMaxDispatchDepth)
+        {
+            struct DepthGuard
+            {
+                uint32_t &depth;
+                ~DepthGuard() { --depth; }
+            } guard{++m_dispatchDepth};
+            fn();
+            return;
+        }
+        executeOnRunLoop(std::forward<F>(fn), priority);
+    }
+
 } // namespace ms
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "RunLoop.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ms
+{
+
+    // Buffered stream socket (TCP, Unix, socketpair) driven by a run loop.
+    // send() only appends to a chained output buffer; the chain goes out
+    // with one gathering sendmsg() on the loop's next iteration, so the
+    // many small messages a chatty protocol queues during one turn cost
+    // one syscall instead of one each. A flush also happens at once when
+    // Options::flushThreshold bytes are queued. Whatever the kernel does
+    // not take stays queued and the fd gets EPOLLOUT interest until it has
+    // drained. Input arrives through a read-mode source; bytes the handler
+    // leaves unconsumed are kept and offered again with the next input, so
+    // it can wait for whole frames.
+    //
+    // Writes pass MSG_NOSIGNAL, so a peer that went away is reported as
+    // -EPIPE rather than raising SIGPIPE. Pipes have no such flag (and are
+    // one-way), so they are not accepted.
+    //
+    // The connection owns the fd. Loop-thread only, including destruction
+    // (or destroy it once the loop has stopped).
+    //
+    // Usage:
+    //   ms::StreamConnection conn;
+    //   conn.open(loop, fd,
+    //             [&](const char *data, size_t size) { return parse(data, size); },
+    //             [&](int error) { ... });
+    //   conn.send(reply.data(), reply.size());
+    class StreamConnection
+    {
+    public:
+        struct Options
+        {
+            size_t chunkSize = 16 * 1024;       // size of one output buffer link
+            size_t flushThreshold = 256 * 1024; // queued bytes that force a flush
+        };
+
+        struct Stats
+        {
+            uint64_t bytesRead = 0;
+            uint64_t bytesWritten = 0;
+            uint64_t sends = 0;  // send() calls
+            uint64_t writes = 0; // sendmsg() calls
+            uint64_t stalls = 0; // flushes that left output for EPOLLOUT
+        };
+
+        // Called with all buffered, unconsumed input; returns how many
+        // bytes it consumed.
+        using DataHandler = std::function<size_t(const char *data, size_t size)>;
+
+        // Called once when the stream ends: 0 at end of file, otherwise
+        // -errno of the failed read or write. The fd is already closed and
+        // unsent output dropped; the handler may destroy the connection.
+        using CloseHandler = std::function<void(int error)>;
+
+        StreamConnection() = default;
+        ~StreamConnection();
+
+        StreamConnection(const StreamConnection &) = delete;
+        StreamConnection &operator=(const StreamConnection &) = delete;
+
+        // Take over connected stream socket `fd` (made non-blocking) and
+        // start reading. Returns false with errno set (ENOTSOCK for a pipe
+        // or file), leaving `fd` with the caller, if it is not a stream
+        // socket. A connection is opened once.
+        template <typename Loop>
+        bool open(Loop &loop, int fd, DataHandler onData, CloseHandler onClose);
+        template <typename Loop>
+        bool open(Loop &loop, int fd, DataHandler onData, CloseHandler onClose, const Options &options);
+
+        // Queue bytes for the next flush. Ignored once closed.
+        void send(const void *data, size_t size);
+        void send(const std::string &data) { send(data.data(), data.size()); }
+
+        // Write queued output now instead of at the end of the turn.
+        void flush();
+
+        // While corked, output is held across iterations until uncork(),
+        // which flushes; the threshold still applies.
+        void cork() { m_corked = true; }
+        void uncork();
+
+        // Stop watching and close the fd now, dropping unsent output. The
+        // close handler is not called.
+        void close();
+
+        bool isOpen() const { return m_fd >= 0; }
+        int fd() const { return m_fd; }
+        size_t pendingOutput() const { return m_outputSize; }
+        Stats stats() const { return m_stats; }
+
+    private:
+        bool setup(int fd, DataHandler onData, CloseHandler onClose, const Options &options);
+        void readReady(const char *data, ssize_t result);
+        void scheduleFlush();
+        // False if the write failed and the connection was closed.
+        bool writeOut();
+        void fail(int error);
+
+        int m_fd = -1;
+        bool m_corked = false;
+        bool m_flushScheduled = false;
+        bool m_waitingWritable = false;
+        Options m_options;
+        DataHandler m_onData;
+        CloseHandler m_onClose;
+        Stats m_stats;
+
+        std::vector<char> m_input; // unconsumed input
+        std::deque<std::vector<char>> m_output;
+        size_t m_outputOffset = 0; // already written from m_output.front()
+        size_t m_outputSize = 0;
+        std::vector<std::vector<char>> m_spareChunks;
+
+        // Cancelled on close; skips a pending flush and tells callbacks
+        // that the connection went away under them.
+        CancelToken m_alive;
+        std::function<void()> m_post;
+        std::function<void(bool)> m_watchWritable;
+        std::function<void()> m_detach;
+    };
+
+    template <typename Loop>
+    bool StreamConnection::open(Loop &loop, int fd, DataHandler onData, CloseHandler onClose)
+    {
+        return open(loop, fd, std::move(onData), std::move(onClose), Options());
+    }
+
+    template <typename Loop>
+    bool StreamConnection::open(Loop &loop, int fd, DataHandler onData, CloseHandler onClose,
+                                const Options &options)
+    {
+        if (!setup(fd, std::move(onData), std::move(onClose), options))
+        {
+            return false;
+        }
+        loop.addReadSource(fd, [this](const char *data, ssize_t result) { readReady(data, result); });
+        m_post = [&loop, this, alive = m_alive] {
+            loop.executeOnRunLoop(
+                [this] {
+                    m_flushScheduled = false;
+                    if (!m_corked)
+                    {
+                        writeOut();
+                    }
+                },
+                alive);
+        };
+        m_watchWritable = [&loop, this, fd](bool on) {
+            loop.setSourceWritable(fd, on ? std::function<void()>([this] { writeOut(); }) : nullptr);
+        };
+        m_detach = [&loop, fd] { loop.removeSource(fd); };
+        return true;
+    }
+
+} // namespace ms
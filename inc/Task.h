@@ -0,0 +1,460 @@
+#pragma once
+
+#include "Future.h"
+#include "RunLoop.h"
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "Task.h needs C++20 coroutines: compile with -std=c++20 and link ms-runloop-coro"
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include <sys/types.h>
+
+namespace ms
+{
+
+    template <typename T = void>
+    class Task;
+
+    namespace detail
+    {
+
+        // Coroutine frame allocator. Frames are rounded up to a size class
+        // and recycled through per-thread free lists, so a steady state of
+        // short-lived tasks does not hit the global heap. Frames larger
+        // than the biggest class fall through to operator new.
+        void *allocateFrame(size_t size);
+        void deallocateFrame(void *frame, size_t size) noexcept;
+
+        class TaskPromiseBase
+        {
+        public:
+            static void *operator new(size_t size) { return allocateFrame(size); }
+            static void operator delete(void *frame, size_t size) noexcept
+            {
+                deallocateFrame(frame, size);
+            }
+
+            // Tasks are lazy: nothing runs until awaited or detached.
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                // Symmetric transfer back to the awaiting coroutine, so a
+                // chain of tasks completes without growing the stack.
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+                {
+                    TaskPromiseBase &promise = h.promise();
+                    if (promise.m_continuation)
+                    {
+                        return promise.m_continuation;
+                    }
+                    if (promise.m_detached)
+                    {
+                        h.destroy();
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void unhandled_exception()
+            {
+                if (m_detached)
+                {
+                    std::terminate();
+                }
+                m_error = std::current_exception();
+            }
+
+            std::coroutine_handle<> m_continuation;
+            std::exception_ptr m_error;
+            bool m_detached = false;
+        };
+
+        template <typename T>
+        class TaskPromise : public TaskPromiseBase
+        {
+        public:
+            Task<T> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U &&value)
+            {
+                m_value.emplace(std::forward<U>(value));
+            }
+
+            T result()
+            {
+                if (m_error)
+                {
+                    std::rethrow_exception(m_error);
+                }
+                return std::move(*m_value);
+            }
+
+        private:
+            std::optional<T> m_value;
+        };
+
+        template <>
+        class TaskPromise<void> : public TaskPromiseBase
+        {
+        public:
+            Task<void> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+
+            void result()
+            {
+                if (m_error)
+                {
+                    std::rethrow_exception(m_error);
+                }
+            }
+        };
+
+    } // namespace detail
+
+    // Lazily-started coroutine returning T.
+    //
+    // Usage:
+    //   ms::Task<int> compute(ms::RunLoop &loop)
+    //   {
+    //       co_await ms::schedule(loop);       // now on the loop thread
+    //       co_await ms::sleepFor(loop, 5ms);
+    //       co_return 42;
+    //   }
+    //
+    //   int v = co_await compute(loop);        // from another coroutine
+    //   auto f = ms::spawn(loop, compute(loop)); // from plain code
+    template <typename T>
+    class [[nodiscard]] Task
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        Task() = default;
+        explicit Task(Handle handle) : m_handle(handle) {}
+        Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_handle)
+                {
+                    m_handle.destroy();
+                }
+                m_handle = std::exchange(other.m_handle, {});
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        bool valid() const { return static_cast<bool>(m_handle); }
+
+        // Start the task on the calling thread and let it free itself when
+        // it completes. An exception escaping a detached task terminates.
+        void detach() &&
+        {
+            Handle handle = std::exchange(m_handle, {});
+            handle.promise().m_detached = true;
+            handle.resume();
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                Handle handle;
+
+                bool await_ready() const noexcept { return handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().m_continuation = awaiting;
+                    return handle;
+                }
+
+                T await_resume() { return handle.promise().result(); }
+            };
+            return Awaiter{m_handle};
+        }
+
+    private:
+        Handle m_handle;
+    };
+
+    // Awaitable returned by schedule(). Always suspends and posts the
+    // resumption to the loop. The posted callable only captures the
+    // coroutine handle, which fits std::function's inline storage, so the
+    // hop itself does not allocate.
+    template <typename Loop>
+    class ScheduleAwaiter
+    {
+    public:
+        ScheduleAwaiter(Loop &loop, RunLoopBase::Priority priority) : m_loop(loop), m_priority(priority) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            m_loop.executeOnRunLoop([h] { h.resume(); }, m_priority);
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        Loop &m_loop;
+        RunLoopBase::Priority m_priority;
+    };
+
+    // Awaitable returned by sleepFor(). Resumes on the loop thread once
+    // the delay has elapsed; a non-positive delay does not suspend.
+    template <typename Loop>
+    class SleepAwaiter
+    {
+    public:
+        SleepAwaiter(Loop &loop, std::chrono::nanoseconds delay) : m_loop(loop), m_delay(delay) {}
+
+        bool await_ready() const noexcept { return m_delay <= std::chrono::nanoseconds::zero(); }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            m_loop.executeAfter(m_delay, [h] { h.resume(); });
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        Loop &m_loop;
+        std::chrono::nanoseconds m_delay;
+    };
+
+    // Awaitable returned by readable() / writable(). Resumes on the loop
+    // thread once the fd is ready.
+    template <typename Loop>
+    class ReadyAwaiter
+    {
+    public:
+        ReadyAwaiter(Loop &loop, int fd, bool writable) : m_loop(loop), m_fd(fd), m_writable(writable) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            if (m_writable)
+            {
+                m_loop.waitWritable(m_fd, [h] { h.resume(); });
+            }
+            else
+            {
+                m_loop.waitReadable(m_fd, [h] { h.resume(); });
+            }
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        Loop &m_loop;
+        int m_fd;
+        bool m_writable;
+    };
+
+    namespace detail
+    {
+
+        // One read() or write() on a non-blocking fd; the loop-independent
+        // half of IoAwaiter.
+        class IoOperation
+        {
+        public:
+            enum class Op
+            {
+                Read,
+                Write,
+            };
+
+            IoOperation(Op op, int fd, void *buf, size_t len) : m_op(op), m_fd(fd), m_buf(buf), m_len(len) {}
+
+            // One attempt at the syscall. False if it would block.
+            bool attempt();
+
+        protected:
+            Op m_op;
+            int m_fd;
+            void *m_buf;
+            size_t m_len;
+            ssize_t m_result = 0;
+        };
+
+    } // namespace detail
+
+    // Awaitable returned by asyncRead() / asyncWrite(): read()/write() on
+    // a non-blocking fd. The syscall is attempted first; only when it would
+    // block does the awaiter wait for readiness and retry. A socket that
+    // already has data therefore completes without suspending or touching
+    // epoll. Resolves to the byte count, or -errno on failure.
+    template <typename Loop>
+    class IoAwaiter : public detail::IoOperation
+    {
+    public:
+        IoAwaiter(Loop &loop, Op op, int fd, void *buf, size_t len) : IoOperation(op, fd, buf, len), m_loop(loop) {}
+
+        bool await_ready() { return attempt(); }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            m_handle = h;
+            arm();
+        }
+
+        ssize_t await_resume() const noexcept { return m_result; }
+
+    private:
+        // Wait for readiness, then retry; resumes the coroutine on the
+        // loop thread once the syscall completes.
+        void arm()
+        {
+            // Capturing only `this` keeps the callable in std::function's
+            // inline storage: no allocation per wait.
+            auto retry = [this] {
+                if (attempt())
+                {
+                    m_handle.resume();
+                }
+                else
+                {
+                    arm();
+                }
+            };
+            if (m_op == Op::Read)
+            {
+                m_loop.waitReadable(m_fd, retry);
+            }
+            else
+            {
+                m_loop.waitWritable(m_fd, retry);
+            }
+        }
+
+        Loop &m_loop;
+        std::coroutine_handle<> m_handle;
+    };
+
+    // Coroutine awaitables on a loop. They are free functions rather than
+    // BasicRunLoop members so the class is the same whether or not a
+    // translation unit is compiled with coroutine support.
+    //   co_await ms::schedule(loop);                          // resume on the loop thread
+    //   co_await ms::sleepFor(loop, 10ms);                    // ... later
+    //   co_await ms::readable(loop, fd);                      // ... once readable
+    //   ssize_t n = co_await ms::asyncRead(loop, fd, buf, len); // bytes or -errno
+    template <typename Policy>
+    ScheduleAwaiter<BasicRunLoop<Policy>> schedule(BasicRunLoop<Policy> &loop,
+                                                   RunLoopBase::Priority priority = RunLoopBase::Priority::Normal)
+    {
+        return {loop, priority};
+    }
+
+    template <typename Policy>
+    SleepAwaiter<BasicRunLoop<Policy>> sleepFor(BasicRunLoop<Policy> &loop, std::chrono::nanoseconds delay)
+    {
+        return {loop, delay};
+    }
+
+    template <typename Policy>
+    ReadyAwaiter<BasicRunLoop<Policy>> readable(BasicRunLoop<Policy> &loop, int fd)
+    {
+        return {loop, fd, false};
+    }
+
+    template <typename Policy>
+    ReadyAwaiter<BasicRunLoop<Policy>> writable(BasicRunLoop<Policy> &loop, int fd)
+    {
+        return {loop, fd, true};
+    }
+
+    template <typename Policy>
+    IoAwaiter<BasicRunLoop<Policy>> asyncRead(BasicRunLoop<Policy> &loop, int fd, void *buf, size_t len)
+    {
+        return {loop, detail::IoOperation::Op::Read, fd, buf, len};
+    }
+
+    template <typename Policy>
+    IoAwaiter<BasicRunLoop<Policy>> asyncWrite(BasicRunLoop<Policy> &loop, int fd, const void *buf, size_t len)
+    {
+        return {loop, detail::IoOperation::Op::Write, fd, const_cast<void *>(buf), len};
+    }
+
+    namespace detail
+    {
+
+        template <typename T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+
+        template <typename Policy, typename T>
+        Task<void> runSpawned(BasicRunLoop<Policy> &loop, Task<T> task, Promise<T> promise)
+        {
+            co_await ms::schedule(loop);
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await std::move(task);
+                    promise.setValue();
+                }
+                else
+                {
+                    promise.setValue(co_await std::move(task));
+                }
+            }
+            catch (...)
+            {
+                promise.setException(std::current_exception());
+            }
+        }
+
+    } // namespace detail
+
+    // Start `task` on `loop` and return a Future for its result, bridging
+    // coroutine code to plain threads (e.g. spawn(...).get() in main()).
+    template <typename Policy, typename T>
+    Future<T> spawn(BasicRunLoop<Policy> &loop, Task<T> task)
+    {
+        Promise<T> promise;
+        Future<T> future = promise.future();
+        detail::runSpawned(loop, std::move(task), std::move(promise)).detach();
+        return future;
+    }
+
+} // namespace ms
@@ -0,0 +1,165 @@
+#include "Acceptor.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace ms
+{
+
+    Acceptor::~Acceptor()
+    {
+        m_alive.cancel();
+        if (m_detach)
+        {
+            m_detach();
+        }
+        close();
+    }
+
+    bool Acceptor::open(const sockaddr *address, socklen_t length, const Options &options)
+    {
+        m_fd = socket(address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        int one = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if ((options.reusePort && setsockopt(m_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) ||
+            bind(m_fd, address, length) != 0 || ::listen(m_fd, options.backlog) != 0)
+        {
+            int saved = errno;
+            close();
+            errno = saved;
+            return false;
+        }
+
+        reopenSpare();
+        m_acceptBudget = options.acceptBudget > 0 ? options.acceptBudget : 1;
+        m_fdRetryDelay = options.fdRetryDelay;
+        return true;
+    }
+
+    void Acceptor::reopenSpare()
+    {
+        if (m_spareFd < 0)
+        {
+            m_spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+    }
+
+    void Acceptor::close()
+    {
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        if (m_spareFd >= 0)
+        {
+            ::close(m_spareFd);
+            m_spareFd = -1;
+        }
+    }
+
+    uint16_t Acceptor::port() const
+    {
+        sockaddr_storage address;
+        socklen_t length = sizeof(address);
+        if (m_fd < 0 || getsockname(m_fd, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+        {
+            return 0;
+        }
+        if (address.ss_family == AF_INET)
+        {
+            return ntohs(reinterpret_cast<const sockaddr_in &>(address).sin_port);
+        }
+        if (address.ss_family == AF_INET6)
+        {
+            return ntohs(reinterpret_cast<const sockaddr_in6 &>(address).sin6_port);
+        }
+        return 0;
+    }
+
+    Acceptor::Stats Acceptor::stats() const
+    {
+        Stats s;
+        s.accepted = m_accepted.load(std::memory_order_relaxed);
+        s.readyEvents = m_readyEvents.load(std::memory_order_relaxed);
+        s.dropped = m_dropped.load(std::memory_order_relaxed);
+        s.backoffs = m_backoffs.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void Acceptor::acceptReady()
+    {
+        m_readyEvents.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < m_acceptBudget; ++i)
+        {
+            int fd = accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0)
+            {
+                m_accepted.fetch_add(1, std::memory_order_relaxed);
+                m_handler(fd);
+                continue;
+            }
+
+            switch (errno)
+            {
+            case EINTR:
+            case ECONNABORTED:
+            case EPROTO:
+                continue;
+            case EMFILE:
+            case ENFILE:
+                // Without a free fd the connection would stay queued and
+                // the level-triggered listener would fire forever.
+                if (m_spareFd >= 0)
+                {
+                    ::close(m_spareFd);
+                    m_spareFd = -1;
+                    int dropped = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (dropped >= 0)
+                    {
+                        ::close(dropped);
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    reopenSpare();
+                    if (dropped >= 0)
+                    {
+                        continue;
+                    }
+                }
+                // No spare to shed the connection with: stop listening
+                // for a while instead of spinning on the ready listener.
+                m_backoffs.fetch_add(1, std::memory_order_relaxed);
+                m_backOff();
+                return;
+            default: // EAGAIN: queue drained
+                return;
+            }
+        }
+    }
+
+    std::vector<char> AcceptorGroup::withPort(const sockaddr *address, socklen_t length, uint16_t port)
+    {
+        std::vector<char> copy(reinterpret_cast<const char *>(address),
+                               reinterpret_cast<const char *>(address) + length);
+        auto *bound = reinterpret_cast<sockaddr *>(copy.data());
+        if (bound->sa_family == AF_INET)
+        {
+            reinterpret_cast<sockaddr_in *>(bound)->sin_port = htons(port);
+        }
+        else if (bound->sa_family == AF_INET6)
+        {
+            reinterpret_cast<sockaddr_in6 *>(bound)->sin6_port = htons(port);
+        }
+        return copy;
+    }
+
+} // namespace ms
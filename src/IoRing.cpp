@@ -0,0 +1,395 @@
+#include "IoRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ms
+{
+
+    namespace
+    {
+        // No liburing: the three syscalls are all the ring needs.
+        int ringSetup(unsigned entries, io_uring_params *params)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        int ringRegister(int fd, unsigned opcode, const void *arg, unsigned count)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+        }
+
+        unsigned *ringField(void *ring, uint32_t offset)
+        {
+            return reinterpret_cast<unsigned *>(static_cast<char *>(ring) + offset);
+        }
+    } // namespace
+
+    IoRing::~IoRing()
+    {
+        m_alive.cancel();
+        if (m_detach)
+        {
+            m_detach();
+        }
+        close();
+    }
+
+    bool IoRing::setup(const Options &options)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_ringFd = ringSetup(options.entries, &params);
+        if (m_ringFd < 0)
+        {
+            m_ringFd = -1;
+            return false;
+        }
+
+        // Map the rings; kernels with IORING_FEAT_SINGLE_MMAP share one
+        // mapping for both.
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+        {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                        IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED)
+        {
+            m_sqRing = nullptr;
+            close();
+            return false;
+        }
+        if (single)
+        {
+            m_cqRing = m_sqRing;
+        }
+        else
+        {
+            m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                            IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED)
+            {
+                m_cqRing = nullptr;
+                close();
+                return false;
+            }
+        }
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe *>(sqes);
+
+        m_sqHead = ringField(m_sqRing, params.sq_off.head);
+        m_sqTail = ringField(m_sqRing, params.sq_off.tail);
+        m_sqArray = ringField(m_sqRing, params.sq_off.array);
+        m_sqMask = *ringField(m_sqRing, params.sq_off.ring_mask);
+        m_sqEntries = params.sq_entries;
+        m_sqLocalTail = *m_sqTail;
+        m_cqHead = ringField(m_cqRing, params.cq_off.head);
+        m_cqTail = ringField(m_cqRing, params.cq_off.tail);
+        m_cqMask = *ringField(m_cqRing, params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(m_cqRing) + params.cq_off.cqes);
+
+        // Registered buffers: one mapping, pinned by the kernel once.
+        m_bufferSize = options.bufferSize;
+        m_bufferCount = options.bufferCount;
+        m_buffersLength = m_bufferSize * m_bufferCount;
+        if (m_buffersLength > 0)
+        {
+            void *buffers = mmap(nullptr, m_buffersLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (buffers == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+            m_buffers = static_cast<char *>(buffers);
+
+            std::vector<iovec> iovecs(options.bufferCount);
+            for (unsigned i = 0; i < options.bufferCount; ++i)
+            {
+                iovecs[i].iov_base = bufferData(static_cast<int>(i));
+                iovecs[i].iov_len = m_bufferSize;
+            }
+            if (ringRegister(m_ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), options.bufferCount) != 0)
+            {
+                close();
+                return false;
+            }
+            for (unsigned i = options.bufferCount; i > 0; --i)
+            {
+                m_freeBuffers.push_back(static_cast<int>(i - 1));
+            }
+        }
+
+        // A sparse file table; slots are filled by registerFile(). Not
+        // fatal if the kernel refuses: operations then use plain fds.
+        if (options.fileSlots > 0)
+        {
+            std::vector<int> table(options.fileSlots, -1);
+            if (ringRegister(m_ringFd, IORING_REGISTER_FILES, table.data(), options.fileSlots) == 0)
+            {
+                for (unsigned i = options.fileSlots; i > 0; --i)
+                {
+                    m_freeFileSlots.push_back(i - 1);
+                }
+            }
+        }
+
+        m_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (m_eventFd < 0 || ringRegister(m_ringFd, IORING_REGISTER_EVENTFD, &m_eventFd, 1) != 0)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void IoRing::close()
+    {
+        if (m_ringFd >= 0)
+        {
+            ::close(m_ringFd);
+            m_ringFd = -1;
+        }
+        if (m_eventFd >= 0)
+        {
+            ::close(m_eventFd);
+            m_eventFd = -1;
+        }
+        if (m_sqes)
+        {
+            munmap(m_sqes, m_sqesSize);
+            m_sqes = nullptr;
+        }
+        if (m_cqRing && m_cqRing != m_sqRing)
+        {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        m_cqRing = nullptr;
+        if (m_sqRing)
+        {
+            munmap(m_sqRing, m_sqRingSize);
+            m_sqRing = nullptr;
+        }
+        if (m_buffers)
+        {
+            munmap(m_buffers, m_buffersLength);
+            m_buffers = nullptr;
+        }
+        m_bufferCount = 0;
+        m_freeBuffers.clear();
+        m_freeFileSlots.clear();
+        m_fileSlots.clear();
+    }
+
+    int IoRing::acquireBuffer()
+    {
+        if (m_freeBuffers.empty())
+        {
+            return -1;
+        }
+        int buffer = m_freeBuffers.back();
+        m_freeBuffers.pop_back();
+        return buffer;
+    }
+
+    void IoRing::releaseBuffer(int buffer)
+    {
+        m_freeBuffers.push_back(buffer);
+    }
+
+    bool IoRing::registerFile(int fd)
+    {
+        if (m_fileSlots.count(fd) != 0)
+        {
+            return true;
+        }
+        if (m_freeFileSlots.empty())
+        {
+            return false;
+        }
+        unsigned slot = m_freeFileSlots.back();
+        io_uring_files_update update;
+        std::memset(&update, 0, sizeof(update));
+        update.offset = slot;
+        update.fds = reinterpret_cast<uintptr_t>(&fd);
+        if (ringRegister(m_ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+        {
+            return false;
+        }
+        m_freeFileSlots.pop_back();
+        m_fileSlots.emplace(fd, slot);
+        return true;
+    }
+
+    void IoRing::unregisterFile(int fd)
+    {
+        auto it = m_fileSlots.find(fd);
+        if (it == m_fileSlots.end())
+        {
+            return;
+        }
+        int empty = -1;
+        io_uring_files_update update;
+        std::memset(&update, 0, sizeof(update));
+        update.offset = it->second;
+        update.fds = reinterpret_cast<uintptr_t>(&empty);
+        ringRegister(m_ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+        m_freeFileSlots.push_back(it->second);
+        m_fileSlots.erase(it);
+    }
+
+    bool IoRing::readFixed(int fd, int buffer, size_t length, uint64_t offset, Completion done)
+    {
+        return prepare(IORING_OP_READ_FIXED, fd, buffer, length, offset, std::move(done));
+    }
+
+    bool IoRing::writeFixed(int fd, int buffer, size_t length, uint64_t offset, Completion done)
+    {
+        return prepare(IORING_OP_WRITE_FIXED, fd, buffer, length, offset, std::move(done));
+    }
+
+    io_uring_sqe *IoRing::nextSqe()
+    {
+        if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries)
+        {
+            submit();
+            if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries)
+            {
+                return nullptr;
+            }
+        }
+        unsigned index = m_sqLocalTail & m_sqMask;
+        m_sqArray[index] = index;
+        ++m_sqLocalTail;
+        io_uring_sqe *sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    bool IoRing::prepare(uint8_t opcode, int fd, int buffer, size_t length, uint64_t offset, Completion done)
+    {
+        if (m_ringFd < 0 || buffer < 0 || static_cast<unsigned>(buffer) >= m_bufferCount || length > m_bufferSize)
+        {
+            return false;
+        }
+        io_uring_sqe *sqe = nextSqe();
+        if (!sqe)
+        {
+            return false;
+        }
+
+        uint32_t slot;
+        if (m_freeCompletions.empty())
+        {
+            slot = static_cast<uint32_t>(m_completions.size());
+            m_completions.push_back(std::move(done));
+        }
+        else
+        {
+            slot = m_freeCompletions.back();
+            m_freeCompletions.pop_back();
+            m_completions[slot] = std::move(done);
+        }
+
+        sqe->opcode = opcode;
+        auto file = m_fileSlots.find(fd);
+        if (file != m_fileSlots.end())
+        {
+            sqe->fd = static_cast<int32_t>(file->second);
+            sqe->flags = IOSQE_FIXED_FILE;
+        }
+        else
+        {
+            sqe->fd = fd;
+        }
+        sqe->off = offset;
+        sqe->addr = reinterpret_cast<uintptr_t>(bufferData(buffer));
+        sqe->len = static_cast<uint32_t>(length);
+        sqe->buf_index = static_cast<uint16_t>(buffer);
+        sqe->user_data = slot;
+
+        if (m_unsubmitted++ == 0 && !m_observerActive && m_poke)
+        {
+            m_poke();
+        }
+        return true;
+    }
+
+    void IoRing::submit()
+    {
+        if (m_unsubmitted == 0)
+        {
+            return;
+        }
+        __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+        int submitted = ringEnter(m_ringFd, m_unsubmitted, 0, 0);
+        if (submitted > 0)
+        {
+            ++m_stats.submitCalls;
+            m_stats.submitted += static_cast<uint64_t>(submitted);
+            m_unsubmitted -= static_cast<unsigned>(submitted);
+        }
+        // On EBUSY/EAGAIN the kernel is short of completion space; the
+        // eventfd fires for pending completions and the next wait retries.
+    }
+
+    void IoRing::reap()
+    {
+        uint64_t count;
+        [[maybe_unused]] auto r = read(m_eventFd, &count, sizeof(count));
+
+        // A completion may destroy the ring.
+        CancelToken alive = m_alive;
+        unsigned head = *m_cqHead;
+        for (;;)
+        {
+            unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+            if (head == tail)
+            {
+                break;
+            }
+            const io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+            auto slot = static_cast<uint32_t>(cqe.user_data);
+            int result = cqe.res;
+            ++head;
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+            // Free the slot first: the completion may queue the next operation.
+            Completion done = std::move(m_completions[slot]);
+            m_completions[slot] = nullptr;
+            m_freeCompletions.push_back(slot);
+            ++m_stats.completed;
+            if (done)
+            {
+                done(result);
+                if (alive.isCancelled())
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+} // namespace ms
@@ -0,0 +1,174 @@
+#include "Process.h"
+
+#include <cerrno>
+#include <csignal>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace ms::detail
+{
+
+    namespace
+    {
+        int pidfdOpen(pid_t pid)
+        {
+#ifdef SYS_pidfd_open
+            return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+            (void)pid;
+            errno = ENOSYS;
+            return -1;
+#endif
+        }
+
+        // The parent keeps the read end, non-blocking; the write end is
+        // dup2()ed into the child, which clears its close-on-exec flag.
+        bool makeCapturePipe(int fds[2])
+        {
+            if (pipe2(fds, O_CLOEXEC) != 0)
+            {
+                return false;
+            }
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            return true;
+        }
+
+        std::vector<char *> cStrings(const std::vector<std::string> &strings)
+        {
+            std::vector<char *> result;
+            result.reserve(strings.size() + 1);
+            for (const auto &s : strings)
+            {
+                result.push_back(const_cast<char *>(s.c_str()));
+            }
+            result.push_back(nullptr);
+            return result;
+        }
+    } // namespace
+
+    SpawnedProcess startProcess(const SpawnOptions &options)
+    {
+        SpawnedProcess process;
+        if (options.argv.empty())
+        {
+            errno = EINVAL;
+            return process;
+        }
+
+        int out[2] = {-1, -1};
+        int err[2] = {-1, -1};
+        auto cleanup = [&] {
+            for (int fd : {out[0], out[1], err[0], err[1]})
+            {
+                closeFd(fd);
+            }
+        };
+        if ((options.onStdout && !makeCapturePipe(out)) || (options.onStderr && !makeCapturePipe(err)))
+        {
+            int saved = errno;
+            cleanup();
+            errno = saved;
+            return process;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (out[1] >= 0)
+        {
+            posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+        }
+        if (err[1] >= 0)
+        {
+            posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+        }
+
+        // Do not pass on the caller's signal state: the loop thread blocks
+        // every signal handled through addSignal(), and a child with
+        // SIGTERM blocked could not be terminated.
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        sigset_t signals;
+        sigemptyset(&signals);
+        posix_spawnattr_setsigmask(&attributes, &signals);
+        sigfillset(&signals);
+        sigdelset(&signals, SIGKILL);
+        sigdelset(&signals, SIGSTOP);
+        posix_spawnattr_setsigdefault(&attributes, &signals);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        auto argv = cStrings(options.argv);
+        auto env = cStrings(options.env);
+        pid_t pid = -1;
+        int rc = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(),
+                              options.env.empty() ? environ : env.data());
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+        closeFd(out[1]);
+        closeFd(err[1]);
+        out[1] = err[1] = -1;
+        if (rc != 0)
+        {
+            cleanup();
+            errno = rc;
+            return process;
+        }
+
+        // The child is ours and unreaped, so its pid cannot be recycled
+        // before the pidfd is open.
+        int pidFd = pidfdOpen(pid);
+        if (pidFd < 0)
+        {
+            int saved = errno;
+            kill(pid, SIGKILL);
+            int status;
+            waitpid(pid, &status, 0);
+            cleanup();
+            errno = saved;
+            return process;
+        }
+
+        process.pid = pid;
+        process.pidFd = pidFd;
+        process.stdoutFd = out[0];
+        process.stderrFd = err[0];
+        return process;
+    }
+
+    bool reapProcess(pid_t pid, int &status)
+    {
+        for (;;)
+        {
+            pid_t r = waitpid(pid, &status, WNOHANG);
+            if (r == pid)
+            {
+                return true;
+            }
+            if (r < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            // ECHILD: someone else reaped it, and its status with it.
+            if (r < 0)
+            {
+                status = SpawnOptions::kStatusUnknown;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    void closeFd(int fd)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+} // namespace ms::detail
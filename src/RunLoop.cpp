@@ -1,15 +1,89 @@
 #include "RunLoop.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <vector>
+
 #include <fcntl.h>
 #include <unistd.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 
 namespace ms
 {
 
-    RunLoop::RunLoop() = default;
+    namespace
+    {
+        // epoll_event.data carries the fd in the low 32 bits and what
+        // kind of registration it belongs to in the high 32 bits.
+        enum class EventKind : uint32_t
+        {
+            Wakeup,
+            Source,
+            IoWait,
+            Timer,
+            Signal,
+            Watch,
+        };
+
+        uint64_t eventData(EventKind kind, int fd)
+        {
+            return (static_cast<uint64_t>(kind) << 32) | static_cast<uint32_t>(fd);
+        }
+
+        EventKind eventKind(uint64_t data) { return static_cast<EventKind>(data >> 32); }
+
+        int eventFd(uint64_t data) { return static_cast<int>(static_cast<uint32_t>(data)); }
+
+        uint32_t sourceEventMask(bool exclusive, bool armed, bool writable)
+        {
+            uint32_t events = (armed ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+                              (writable ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            if (events != 0 && exclusive)
+            {
+                events |= EPOLLEXCLUSIVE;
+            }
+            return events;
+        }
+
+        // epoll_pwait2 (nanosecond timeouts) needs Linux 5.11. Probe it
+        // with a zero timeout; only ENOSYS means it is missing.
+        bool epollPwait2Supported(int epollFd)
+        {
+#ifdef SYS_epoll_pwait2
+            struct epoll_event ev;
+            struct timespec zero
+            {
+            };
+            return syscall(SYS_epoll_pwait2, epollFd, &ev, 1, &zero, nullptr, 0) >= 0 || errno != ENOSYS;
+#else
+            (void)epollFd;
+            return false;
+#endif
+        }
+
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                          std::atomic<uint32_t>::is_always_lock_free,
+                      "futex word must be a plain 32-bit integer");
+
+        uint32_t *futexAddress(std::atomic<uint32_t> &word)
+        {
+            return reinterpret_cast<uint32_t *>(&word);
+        }
+    } // namespace
+
+    template <typename Policy>
+    BasicRunLoop<Policy>::BasicRunLoop() = default;
 
-    RunLoop::~RunLoop()
+    template <typename Policy>
+    BasicRunLoop<Policy>::~BasicRunLoop()
     {
         if (m_running.load())
         {
@@ -21,124 +95,1778 @@ namespace ms
             close(m_wakeupFd[0]);
             close(m_wakeupFd[1]);
         }
+        if (m_timerFd >= 0)
+        {
+            close(m_timerFd);
+        }
+        if (m_signalFd >= 0)
+        {
+            close(m_signalFd);
+        }
+        if (m_inotifyFd >= 0)
+        {
+            close(m_inotifyFd);
+        }
         if (m_epollFd >= 0)
         {
             close(m_epollFd);
         }
     }
 
-    void RunLoop::init(const char *name)
+    template <typename Policy>
+    void BasicRunLoop<Policy>::init(const char *name)
+    {
+        init(name, Options());
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::init(const char *name, const Options &options)
     {
         m_name = name;
+        m_options = options;
+        // A zero-byte read would be reported as end of file.
+        m_options.readBufferSize = std::max<size_t>(m_options.readBufferSize, 1);
         m_epollFd = epoll_create1(EPOLL_CLOEXEC);
 
-        if (pipe2(m_wakeupFd, O_CLOEXEC | O_NONBLOCK) == 0)
+        // A single-threaded loop is only ever woken by its own fds.
+        if (Policy::kThreadSafe && pipe2(m_wakeupFd, O_CLOEXEC | O_NONBLOCK) == 0)
         {
             struct epoll_event ev
             {
             };
             ev.events = EPOLLIN;
-            ev.data.fd = m_wakeupFd[0];
+            ev.data.u64 = eventData(EventKind::Wakeup, m_wakeupFd[0]);
             epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeupFd[0], &ev);
         }
+
+        initTimerBackend();
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::initTimerBackend()
+    {
+        TimerResolution wanted = m_options.timerResolution;
+        m_timerBackend = TimerResolution::Millisecond;
+
+        if (wanted == TimerResolution::High || wanted == TimerResolution::EpollPwait2)
+        {
+            if (epollPwait2Supported(m_epollFd))
+            {
+                m_timerBackend = TimerResolution::EpollPwait2;
+                return;
+            }
+            wanted = TimerResolution::TimerFd;
+        }
+
+        if (wanted == TimerResolution::TimerFd)
+        {
+            m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+            if (m_timerFd < 0)
+            {
+                return;
+            }
+            struct epoll_event ev
+            {
+            };
+            ev.events = EPOLLIN;
+            ev.data.u64 = eventData(EventKind::Timer, m_timerFd);
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_timerFd, &ev);
+            m_timerBackend = TimerResolution::TimerFd;
+        }
     }
 
-    void RunLoop::run()
+    template <typename Policy>
+    void BasicRunLoop<Policy>::run()
     {
+        m_loopThread.store(std::this_thread::get_id(), std::memory_order_release);
         m_running.store(true, std::memory_order_release);
 
-        constexpr int MAX_EVENTS = 32;
-        struct epoll_event events[MAX_EVENTS];
+        // Sized once for the largest batch the loop may adapt up to.
+        size_t minBatch = std::max<size_t>(m_options.eventBatch, 1);
+        std::vector<struct epoll_event> events(std::max(minBatch, m_options.maxEventBatch));
+        m_eventBatch.store(minBatch, std::memory_order_relaxed);
+        m_sparseWaits = 0;
+
+        // Changes queued while the loop was stopped come before anything
+        // the first posted callables register.
+        if (m_sourceCommandsPending.load(std::memory_order_acquire))
+        {
+            applySourceCommands();
+        }
 
         while (!m_stopRequested.load(std::memory_order_acquire))
         {
-            // Execute posted callables
+            uint64_t iteration = m_iteration.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (m_observersChanged.load(std::memory_order_acquire))
             {
-                std::vector<std::function<void()>> batch;
+                m_observersChanged.store(false, std::memory_order_relaxed);
+                std::lock_guard<Mutex> lock(m_observerMutex);
+                for (auto &phase : m_phaseObservers)
                 {
-                    std::lock_guard<std::mutex> lock(m_postMutex);
-                    batch.swap(m_postQueue);
+                    phase.clear();
                 }
-                for (auto &fn : batch)
+                for (const auto &observer : m_observers)
                 {
-                    fn();
+                    m_phaseObservers[static_cast<size_t>(observer.phase)].push_back(
+                        PhaseObserver{observer.id, observer.fn});
                 }
             }
+            notifyObservers(Phase::BeforePosts, iteration);
+
+            // Execute posted callables. If the budget left work behind,
+            // only poll so fd events and new High work are not held up.
+            // Pending idle work also polls: the next quiet iteration runs it.
+            // Work queued from the loop thread skips the wakeup pipe, so
+            // anything posted during the batch also turns the wait into a poll.
+            m_wakeupPending = false;
+            bool morePosted = false;
+            size_t ranPosted = runPostedBatch(morePosted);
+
+            notifyObservers(Phase::BeforeWait, iteration);
+            drainMicrotasks();
+
+            auto batch = static_cast<int>(m_eventBatch.load(std::memory_order_relaxed));
+            if (m_sourceCommandsPending.load(std::memory_order_acquire))
+            {
+                applySourceCommands();
+            }
+
+            bool poll = morePosted || m_wakeupPending || !m_idleTasks.empty();
+            int n = 0;
+            if (Policy::kThreadSafe && m_options.parkOnFutex)
+            {
+                n = waitOrPark(events.data(), batch, poll);
+            }
+            else
+            {
+                n = waitForEvents(events.data(), batch, poll);
+            }
+            if (n > 0)
+            {
+                adaptEventBatch(n);
+            }
 
-            int n = epoll_wait(m_epollFd, events, MAX_EVENTS, -1);
+            // Removals queued while the loop slept must win over events
+            // for the same fds in this batch.
+            if (m_sourceCommandsPending.load(std::memory_order_acquire))
+            {
+                applySourceCommands();
+            }
 
             for (int i = 0; i < n; ++i)
             {
-                if (events[i].data.fd == m_wakeupFd[0])
+                int fd = eventFd(events[i].data.u64);
+                switch (eventKind(events[i].data.u64))
+                {
+                case EventKind::Wakeup:
                 {
                     char buf[64];
                     while (read(m_wakeupFd[0], buf, sizeof(buf)) > 0) {}
+                    break;
                 }
-                else
+                case EventKind::Source:
                 {
-                    std::function<void()> handler;
+                    // Lock-free: the table belongs to the loop thread.
+                    auto it = m_sources.find(fd);
+                    if (it == m_sources.end())
+                    {
+                        break;
+                    }
+                    Source *source = it->second.get();
+                    uint32_t revents = events[i].events;
+                    if (source->onWritable && (revents & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
                     {
-                        std::lock_guard<std::mutex> lock(m_sourcesMutex);
-                        auto it = m_sources.find(events[i].data.fd);
-                        if (it != m_sources.end())
+                        // A copy: the handler typically clears itself once
+                        // its output has drained.
+                        auto onWritable = source->onWritable;
+                        onWritable();
+                        // The handler may have removed or replaced the
+                        // source; retired ones stay allocated until the
+                        // batch ends, so the pointer compare is safe.
+                        it = m_sources.find(fd);
+                        if (it == m_sources.end() || it->second.get() != source)
                         {
-                            handler = it->second;
+                            break;
                         }
                     }
-                    if (handler)
+                    if ((revents & ~static_cast<uint32_t>(EPOLLOUT)) == 0)
+                    {
+                        break;
+                    }
+                    if (source->paused)
+                    {
+                        // Ready while paused: stop hearing about it until
+                        // resumeSource().
+                        setSourceInterest(fd, *source, false);
+                        break;
+                    }
+                    if (source->invoke)
+                    {
+                        source->invoke(source->object);
+                    }
+                    else if (source->onRead)
+                    {
+                        dispatchReadSource(fd, *source);
+                    }
+                    else
                     {
-                        handler();
+                        source->fn();
                     }
+                    break;
                 }
+                case EventKind::IoWait:
+                    dispatchIoWait(fd, events[i].events);
+                    break;
+                case EventKind::Signal:
+                    dispatchSignals();
+                    break;
+                case EventKind::Watch:
+                    dispatchWatches(fd);
+                    break;
+                case EventKind::Timer:
+                {
+                    // Expiry only ends the wait; runDueTimers() checks the clock.
+                    uint64_t expirations;
+                    [[maybe_unused]] auto r = read(m_timerFd, &expirations, sizeof(expirations));
+                    m_timerFdDeadline = Clock::time_point::min();
+                    break;
+                }
+                }
+                drainMicrotasks();
+            }
+            m_retiredSources.clear();
+
+            bool firedTimers = runDueTimers();
+
+            if (!m_idleTasks.empty())
+            {
+                runIdleTasks(ranPosted == 0 && n <= 0 && !firedTimers);
             }
+
+            notifyObservers(Phase::AfterHandlers, iteration);
         }
 
         m_running.store(false, std::memory_order_release);
         m_stopRequested.store(false, std::memory_order_release);
+        m_loopThread.store(std::thread::id(), std::memory_order_release);
+
+        // Nothing applies queued removals now; stop waiting for them.
+        if constexpr (Policy::kThreadSafe)
+        {
+            {
+                std::lock_guard<Mutex> lock(m_sourcesMutex);
+            }
+            m_sourceCommandsDone.notify_all();
+        }
     }
 
-    void RunLoop::stop()
+    template <typename Policy>
+    void BasicRunLoop<Policy>::stop()
     {
         m_stopRequested.store(true, std::memory_order_release);
         wakeup();
     }
 
-    void RunLoop::executeOnRunLoop(std::function<void()> fn)
+    namespace
+    {
+        bool isCancelled(const std::shared_ptr<std::atomic<bool>> &flag)
+        {
+            return flag && flag->load(std::memory_order_acquire);
+        }
+    } // namespace
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::executeOnRunLoop(std::function<void()> fn, Priority priority)
+    {
+        enqueue({std::move(fn), nullptr}, priority);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::executeOnRunLoop(std::function<void()> fn, CancelToken token, Priority priority)
+    {
+        enqueue({std::move(fn), std::move(token.m_state)}, priority);
+    }
+
+    template <typename Policy>
+    CancelToken BasicRunLoop<Policy>::executeCancellable(std::function<void()> fn, Priority priority)
+    {
+        CancelToken token;
+        enqueue({std::move(fn), token.m_state}, priority);
+        return token;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::enqueue(PostedTask task, Priority priority)
     {
+        auto lane = static_cast<size_t>(priority);
         {
-            std::lock_guard<std::mutex> lock(m_postMutex);
-            m_postQueue.push_back(std::move(fn));
+            std::lock_guard<Mutex> lock(m_postMutex);
+            m_postQueues[lane].push_back(std::move(task));
         }
+        m_laneCounters[lane].posted.fetch_add(1, std::memory_order_relaxed);
         wakeup();
     }
 
-    void RunLoop::addSource(int fd, std::function<void()> handler)
+    template <typename Policy>
+    RunLoopBase::Stats BasicRunLoop<Policy>::stats() const
     {
+        Stats s;
+        for (size_t lane = 0; lane < kPriorityCount; ++lane)
         {
-            std::lock_guard<std::mutex> lock(m_sourcesMutex);
-            m_sources[fd] = std::move(handler);
+            s.lanes[lane].posted = m_laneCounters[lane].posted.load(std::memory_order_relaxed);
+            s.lanes[lane].executed = m_laneCounters[lane].executed.load(std::memory_order_relaxed);
+            s.lanes[lane].deferred = m_laneCounters[lane].deferred.load(std::memory_order_relaxed);
+            s.lanes[lane].cancelled = m_laneCounters[lane].cancelled.load(std::memory_order_relaxed);
         }
+        s.timersFired = m_timersFired.load(std::memory_order_relaxed);
+        s.timerWakeups = m_timerWakeups.load(std::memory_order_relaxed);
+        s.idleExecuted = m_idleExecuted.load(std::memory_order_relaxed);
+        s.idleOverdue = m_idleOverdue.load(std::memory_order_relaxed);
+        s.microtasksExecuted = m_microtasksExecuted.load(std::memory_order_relaxed);
+        s.eventWaits = m_eventWaits.load(std::memory_order_relaxed);
+        s.eventsReceived = m_eventsReceived.load(std::memory_order_relaxed);
+        s.fullBatches = m_fullBatches.load(std::memory_order_relaxed);
+        s.eventBatch = m_eventBatch.load(std::memory_order_relaxed);
+        s.futexParks = m_futexParks.load(std::memory_order_relaxed);
+        s.pooledReads = m_pooledReads.load(std::memory_order_relaxed);
+        s.readBuffers = m_readBuffersAllocated.load(std::memory_order_relaxed);
+        return s;
+    }
 
-        struct epoll_event ev
+    template <typename Policy>
+    void BasicRunLoop<Policy>::adaptEventBatch(int n)
+    {
+        // Waits this many sparse batches in a row before shrinking, so a
+        // brief lull does not undo a burst's growth.
+        constexpr size_t kSparseWaitsToShrink = 64;
+
+        size_t batch = m_eventBatch.load(std::memory_order_relaxed);
+        auto events = static_cast<size_t>(n);
+        m_eventWaits.fetch_add(1, std::memory_order_relaxed);
+        m_eventsReceived.fetch_add(events, std::memory_order_relaxed);
+        if (events == batch)
         {
-        };
-        ev.events = EPOLLIN;
-        ev.data.fd = fd;
-        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+            m_fullBatches.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        size_t minBatch = std::max<size_t>(m_options.eventBatch, 1);
+        if (m_options.maxEventBatch <= minBatch)
+        {
+            return;
+        }
+        if (events == batch)
+        {
+            m_sparseWaits = 0;
+            m_eventBatch.store(std::min(batch * 2, m_options.maxEventBatch), std::memory_order_relaxed);
+        }
+        else if (events <= batch / 4 && batch > minBatch)
+        {
+            if (++m_sparseWaits >= kSparseWaitsToShrink)
+            {
+                m_sparseWaits = 0;
+                m_eventBatch.store(std::max(batch / 2, minBatch), std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            m_sparseWaits = 0;
+        }
+    }
+
+    template <typename Policy>
+    size_t BasicRunLoop<Policy>::runPostedBatch(bool &more)
+    {
+        // Swap every lane out under one short lock, then decide what to run.
+        std::vector<PostedTask> incoming[kPriorityCount];
+        std::vector<IdleTask> idle;
+        {
+            std::lock_guard<Mutex> lock(m_postMutex);
+            for (size_t lane = 0; lane < kPriorityCount; ++lane)
+            {
+                incoming[lane].swap(m_postQueues[lane]);
+            }
+            idle.swap(m_idleQueue);
+        }
+        for (auto &task : idle)
+        {
+            m_nextIdleDeadline = std::min(m_nextIdleDeadline, task.deadline);
+            m_idleTasks.push_back(std::move(task));
+        }
+
+        const bool limited = m_options.postBudget != 0;
+        size_t remaining = m_options.postBudget;
+        size_t executed = 0;
+
+        for (size_t lane = 0; lane < kPriorityCount; ++lane)
+        {
+            auto &deferred = m_deferredPosts[lane];
+            auto &fresh = incoming[lane];
+
+            size_t quota = deferred.size() + fresh.size();
+            if (limited && lane != static_cast<size_t>(Priority::High))
+            {
+                quota = std::min(quota, std::max(remaining, m_options.minLaneQuota));
+                remaining -= std::min(quota, remaining);
+            }
+
+            // Cancelled callables are dropped without counting against the
+            // quota: checking the flag is all they cost.
+            size_t ran = 0;
+            size_t skipped = 0;
+            auto runOne = [&](PostedTask &task) {
+                if (isCancelled(task.cancelled))
+                {
+                    ++skipped;
+                    return;
+                }
+                task.fn();
+                drainMicrotasks();
+                ++ran;
+            };
+
+            // Older (deferred) callables first to keep per-lane FIFO order.
+            while (ran < quota && !deferred.empty())
+            {
+                PostedTask task = std::move(deferred.front());
+                deferred.pop_front();
+                runOne(task);
+            }
+
+            size_t i = 0;
+            for (; ran < quota && i < fresh.size(); ++i)
+            {
+                runOne(fresh[i]);
+            }
+            for (; i < fresh.size(); ++i)
+            {
+                deferred.push_back(std::move(fresh[i]));
+            }
+
+            executed += ran;
+            m_laneCounters[lane].executed.fetch_add(ran, std::memory_order_relaxed);
+            m_laneCounters[lane].cancelled.fetch_add(skipped, std::memory_order_relaxed);
+            if (!deferred.empty())
+            {
+                m_laneCounters[lane].deferred.fetch_add(1, std::memory_order_relaxed);
+                more = true;
+            }
+        }
+
+        return executed;
     }
 
-    void RunLoop::removeSource(int fd)
+    template <typename Policy>
+    void BasicRunLoop<Policy>::executeWhenIdle(std::function<void()> fn)
     {
-        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        enqueueIdle({std::move(fn), Clock::time_point::max()});
+    }
 
-        std::lock_guard<std::mutex> lock(m_sourcesMutex);
-        m_sources.erase(fd);
+    template <typename Policy>
+    void BasicRunLoop<Policy>::executeWhenIdle(std::function<void()> fn, std::chrono::nanoseconds maxDeferral)
+    {
+        enqueueIdle({std::move(fn), Clock::now() + maxDeferral});
     }
 
-    void RunLoop::wakeup()
+    template <typename Policy>
+    void BasicRunLoop<Policy>::executeMicrotask(std::function<void()> fn)
     {
-        char byte = 1;
-        [[maybe_unused]] auto r = write(m_wakeupFd[1], &byte, 1);
+        if (!isOnLoopThread())
+        {
+            executeOnRunLoop(std::move(fn));
+            return;
+        }
+        m_microtasks.push_back(std::move(fn));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::runMicrotasks()
+    {
+        // Microtasks queued by microtasks run in this same drain.
+        while (!m_microtasks.empty())
+        {
+            m_runningMicrotasks.swap(m_microtasks);
+            for (auto &fn : m_runningMicrotasks)
+            {
+                fn();
+            }
+            m_microtasksExecuted.fetch_add(m_runningMicrotasks.size(), std::memory_order_relaxed);
+            m_runningMicrotasks.clear();
+        }
+    }
+
+    template <typename Policy>
+    RunLoopBase::ObserverId BasicRunLoop<Policy>::addObserver(Phase phase, std::function<void(uint64_t)> fn)
+    {
+        std::lock_guard<Mutex> lock(m_observerMutex);
+        ObserverId id = m_nextObserverId++;
+        m_observers.push_back(Observer{id, phase, std::move(fn)});
+        m_observersChanged.store(true, std::memory_order_release);
+        return id;
+    }
+
+    template <typename Policy>
+    bool BasicRunLoop<Policy>::removeObserver(ObserverId id)
+    {
+        std::lock_guard<Mutex> lock(m_observerMutex);
+        auto it = std::find_if(m_observers.begin(), m_observers.end(),
+                               [id](const Observer &observer) { return observer.id == id; });
+        if (it == m_observers.end())
+        {
+            return false;
+        }
+        if (isOnLoopThread())
+        {
+            // Tombstone rather than erase: the snapshot may be mid-iteration,
+            // possibly inside this very observer.
+            for (auto &entry : m_phaseObservers[static_cast<size_t>(it->phase)])
+            {
+                if (entry.id == id)
+                {
+                    entry.id = 0;
+                }
+            }
+        }
+        m_observers.erase(it);
+        m_observersChanged.store(true, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::notifyObservers(Phase phase, uint64_t iteration)
+    {
+        for (auto &entry : m_phaseObservers[static_cast<size_t>(phase)])
+        {
+            if (entry.id != 0)
+            {
+                entry.fn(iteration);
+                drainMicrotasks();
+            }
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::enqueueIdle(IdleTask task)
+    {
+        {
+            std::lock_guard<Mutex> lock(m_postMutex);
+            m_idleQueue.push_back(std::move(task));
+        }
+        wakeup();
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::runIdleTasks(bool idle)
+    {
+        if (idle)
+        {
+            // Only what was queued before this quiet iteration; idle tasks
+            // queued by idle tasks wait for the next one.
+            size_t count = m_idleTasks.size();
+            for (size_t i = 0; i < count; ++i)
+            {
+                IdleTask task = std::move(m_idleTasks.front());
+                m_idleTasks.pop_front();
+                task.fn();
+                drainMicrotasks();
+            }
+            m_idleExecuted.fetch_add(count, std::memory_order_relaxed);
+            m_nextIdleDeadline = Clock::time_point::max();
+            return;
+        }
+
+        // Busy iteration: only tasks that have waited past their deadline.
+        auto now = Clock::now();
+        if (now < m_nextIdleDeadline)
+        {
+            return;
+        }
+        size_t overdue = 0;
+        m_nextIdleDeadline = Clock::time_point::max();
+        for (size_t i = 0, count = m_idleTasks.size(); i < count; ++i)
+        {
+            IdleTask task = std::move(m_idleTasks.front());
+            m_idleTasks.pop_front();
+            if (task.deadline <= now)
+            {
+                task.fn();
+                drainMicrotasks();
+                ++overdue;
+            }
+            else
+            {
+                m_nextIdleDeadline = std::min(m_nextIdleDeadline, task.deadline);
+                m_idleTasks.push_back(std::move(task));
+            }
+        }
+        m_idleExecuted.fetch_add(overdue, std::memory_order_relaxed);
+        m_idleOverdue.fetch_add(overdue, std::memory_order_relaxed);
+    }
+
+    namespace
+    {
+        constexpr uint32_t kTimerSlotBits = 32;
+    } // namespace
+
+    template <typename Policy>
+    RunLoopBase::TimerId BasicRunLoop<Policy>::executeAfter(std::chrono::nanoseconds delay,
+                                           std::function<void()> fn)
+    {
+        return scheduleTimer(delay, std::chrono::nanoseconds::zero(), TimerOptions(),
+                             {std::move(fn), nullptr});
+    }
+
+    template <typename Policy>
+    RunLoopBase::TimerId BasicRunLoop<Policy>::executeAfter(std::chrono::nanoseconds delay,
+                                           std::function<void()> fn, CancelToken token)
+    {
+        return scheduleTimer(delay, std::chrono::nanoseconds::zero(), TimerOptions(),
+                             {std::move(fn), std::move(token.m_state)});
+    }
+
+    template <typename Policy>
+    RunLoopBase::TimerId BasicRunLoop<Policy>::executeEvery(std::chrono::nanoseconds interval,
+                                           std::function<void()> fn)
+    {
+        return executeEvery(interval, std::move(fn), TimerOptions());
+    }
+
+    template <typename Policy>
+    RunLoopBase::TimerId BasicRunLoop<Policy>::executeEvery(std::chrono::nanoseconds interval,
+                                           std::function<void()> fn, const TimerOptions &options)
+    {
+        // A zero interval would spin; one nanosecond is the tightest period.
+        interval = std::max(interval, std::chrono::nanoseconds(1));
+        return scheduleTimer(interval, interval, options, {std::move(fn), nullptr});
+    }
+
+    template <typename Policy>
+    RunLoopBase::TimerId BasicRunLoop<Policy>::scheduleTimer(std::chrono::nanoseconds delay,
+                                            std::chrono::nanoseconds interval,
+                                            const TimerOptions &options, PostedTask task)
+    {
+        auto deadline = Clock::now() + delay;
+        auto slack = std::max(options.slack, std::chrono::nanoseconds::zero());
+        bool earliest;
+        TimerId id;
+        {
+            std::lock_guard<Mutex> lock(m_timerMutex);
+
+            uint32_t slot;
+            if (!m_freeTimerSlots.empty())
+            {
+                slot = m_freeTimerSlots.back();
+                m_freeTimerSlots.pop_back();
+            }
+            else
+            {
+                slot = static_cast<uint32_t>(m_timerSlots.size());
+                m_timerSlots.emplace_back();
+            }
+
+            TimerSlot &timer = m_timerSlots[slot];
+            timer.fn = std::move(task.fn);
+            timer.cancelled = std::move(task.cancelled);
+            timer.interval = interval;
+            timer.slack = slack;
+            timer.missedTicks = options.missedTicks;
+            timer.active = true;
+
+            m_timerHeap.push_back({deadline, deadline + slack, slot, timer.generation});
+            std::push_heap(m_timerHeap.begin(), m_timerHeap.end(), laterDeadline);
+
+            earliest = m_timerHeap.front().slot == slot;
+            id = (static_cast<TimerId>(timer.generation) << kTimerSlotBits) | slot;
+        }
+
+        // A new earliest deadline shortens the wait the loop may already be in.
+        if (earliest)
+        {
+            wakeup();
+        }
+        return id;
+    }
+
+    template <typename Policy>
+    bool BasicRunLoop<Policy>::cancelTimer(TimerId id)
+    {
+        auto slot = static_cast<uint32_t>(id);
+        auto generation = static_cast<uint32_t>(id >> kTimerSlotBits);
+
+        PostedTask task;
+        {
+            std::lock_guard<Mutex> lock(m_timerMutex);
+            if (slot >= m_timerSlots.size())
+            {
+                return false;
+            }
+            TimerSlot &timer = m_timerSlots[slot];
+            if (!timer.active || timer.generation != generation)
+            {
+                return false;
+            }
+            // The heap entry stays behind and is dropped when it surfaces.
+            task.fn = std::move(timer.fn);
+            task.cancelled = std::move(timer.cancelled);
+            releaseTimerSlot(slot);
+        }
+        // `task` is destroyed here, outside the lock, in case its captures
+        // touch the loop.
+        return true;
     }
 
+    template <typename Policy>
+    void BasicRunLoop<Policy>::releaseTimerSlot(uint32_t slot)
+    {
+        TimerSlot &timer = m_timerSlots[slot];
+        timer.fn = nullptr;
+        timer.cancelled = nullptr;
+        timer.active = false;
+        ++timer.generation;
+        m_freeTimerSlots.push_back(slot);
+    }
+
+    template <typename Policy>
+    bool BasicRunLoop<Policy>::isTimerActive(uint32_t slot, uint32_t generation)
+    {
+        std::lock_guard<Mutex> lock(m_timerMutex);
+        const TimerSlot &timer = m_timerSlots[slot];
+        return timer.active && timer.generation == generation;
+    }
+
+    template <typename Policy>
+    RunLoopBase::Clock::time_point BasicRunLoop<Policy>::nextTimerDeadline()
+    {
+        std::lock_guard<Mutex> lock(m_timerMutex);
+
+        while (!m_timerHeap.empty())
+        {
+            const TimerEntry &top = m_timerHeap.front();
+            if (m_timerSlots[top.slot].generation == top.generation)
+            {
+                break;
+            }
+            std::pop_heap(m_timerHeap.begin(), m_timerHeap.end(), laterDeadline);
+            m_timerHeap.pop_back();
+        }
+
+        // Sleep until the first timer runs out of slack; everything whose
+        // window has opened by then fires in the same wakeup.
+        return m_timerHeap.empty() ? Clock::time_point::max() : m_timerHeap.front().latest;
+    }
+
+    template <typename Policy>
+    int BasicRunLoop<Policy>::waitForEvents(struct epoll_event *events, int maxEvents, bool poll)
+    {
+        if (poll)
+        {
+            return epoll_wait(m_epollFd, events, maxEvents, 0);
+        }
+
+        auto deadline = nextTimerDeadline();
+        if (deadline == Clock::time_point::max())
+        {
+            if (m_timerBackend == TimerResolution::TimerFd)
+            {
+                armTimerFd(deadline);
+            }
+            return epoll_wait(m_epollFd, events, maxEvents, -1);
+        }
+
+        auto remaining = deadline - Clock::now();
+        if (remaining <= Clock::duration::zero())
+        {
+            return epoll_wait(m_epollFd, events, maxEvents, 0);
+        }
+
+        switch (m_timerBackend)
+        {
+#ifdef SYS_epoll_pwait2
+        case TimerResolution::EpollPwait2:
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+            struct timespec timeout
+            {
+            };
+            timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+            timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+            return static_cast<int>(
+                syscall(SYS_epoll_pwait2, m_epollFd, events, maxEvents, &timeout, nullptr, 0));
+        }
+#endif
+        case TimerResolution::TimerFd:
+            armTimerFd(deadline);
+            return epoll_wait(m_epollFd, events, maxEvents, -1);
+        default:
+            break;
+        }
+
+        // Round up so the loop never wakes just before the deadline.
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+        return epoll_wait(m_epollFd, events, maxEvents, ms > INT_MAX ? INT_MAX : static_cast<int>(ms));
+    }
+
+    template <typename Policy>
+    int BasicRunLoop<Policy>::waitOrPark(struct epoll_event *events, int maxEvents, bool poll)
+    {
+        bool parking = m_fdCount.load(std::memory_order_seq_cst) == 0;
+        if (parking && poll)
+        {
+            return 0; // nothing to poll: no fds, and timers are checked by the clock
+        }
+
+        // Read the futex word before announcing the park: a wake that lands
+        // in between changes the word and the futex wait returns at once.
+        uint32_t seq = m_futexWord.load(std::memory_order_acquire);
+        m_waitState.store(parking ? kParked : kInEpoll, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int n = 0;
+        bool pending = hasPendingWork(parking);
+        if (!parking)
+        {
+            n = waitForEvents(events, maxEvents, poll || pending);
+        }
+        else if (!pending)
+        {
+            struct timespec timeout
+            {
+            };
+            struct timespec *timeoutPtr = nullptr;
+            auto deadline = nextTimerDeadline();
+            if (deadline != Clock::time_point::max())
+            {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+                ns = std::max<decltype(ns)>(ns, 0);
+                timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+                timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+                timeoutPtr = &timeout;
+            }
+            if (!timeoutPtr || timeout.tv_sec > 0 || timeout.tv_nsec > 0)
+            {
+                m_futexParks.fetch_add(1, std::memory_order_relaxed);
+                syscall(SYS_futex, futexAddress(m_futexWord), FUTEX_WAIT_PRIVATE, seq, timeoutPtr, nullptr, 0);
+            }
+        }
+
+        m_waitState.store(kRunning, std::memory_order_seq_cst);
+        return n;
+    }
+
+    template <typename Policy>
+    bool BasicRunLoop<Policy>::hasPendingWork(bool parking)
+    {
+        if (m_stopRequested.load(std::memory_order_acquire))
+        {
+            return true;
+        }
+        if (parking && m_fdCount.load(std::memory_order_seq_cst) != 0)
+        {
+            return true;
+        }
+        if (m_sourceCommandsPending.load(std::memory_order_seq_cst))
+        {
+            return true;
+        }
+        std::lock_guard<Mutex> lock(m_postMutex);
+        if (!m_idleQueue.empty())
+        {
+            return true;
+        }
+        for (const auto &queue : m_postQueues)
+        {
+            if (!queue.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::armTimerFd(Clock::time_point deadline)
+    {
+        if (deadline == m_timerFdDeadline)
+        {
+            return;
+        }
+        m_timerFdDeadline = deadline;
+
+        // steady_clock is CLOCK_MONOTONIC, so the deadline can be handed
+        // to the kernel as an absolute time. A zero value disarms.
+        struct itimerspec spec
+        {
+        };
+        if (deadline != Clock::time_point::max())
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch())
+                          .count();
+            spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+        }
+        timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    template <typename Policy>
+    bool BasicRunLoop<Policy>::runDueTimers()
+    {
+        {
+            std::lock_guard<Mutex> lock(m_timerMutex);
+
+            // The heap is ordered by latest firing time. Keep firing from
+            // the top while each timer's window has opened (deadline has
+            // passed), in the spirit of the kernel's hrtimer slack. This
+            // stops at the first closed window, so an open one behind it
+            // waits for a later wakeup.
+            auto now = Clock::now();
+            while (!m_timerHeap.empty())
+            {
+                TimerEntry entry = m_timerHeap.front();
+                TimerSlot &timer = m_timerSlots[entry.slot];
+                bool stale = !timer.active || timer.generation != entry.generation;
+                if (!stale && entry.deadline > now)
+                {
+                    break;
+                }
+                std::pop_heap(m_timerHeap.begin(), m_timerHeap.end(), laterDeadline);
+                m_timerHeap.pop_back();
+                if (stale)
+                {
+                    continue;
+                }
+
+                bool periodic = timer.interval != std::chrono::nanoseconds::zero();
+                DueTimer due{{std::move(timer.fn), timer.cancelled}, entry.slot, entry.generation, 1, periodic};
+                if (!periodic)
+                {
+                    releaseTimerSlot(entry.slot);
+                }
+                else
+                {
+                    // Next deadline stays on the original phase. Intervals
+                    // missed while the loop was busy are either skipped or
+                    // fired back to back.
+                    auto missed = static_cast<uint64_t>((now - entry.deadline) / timer.interval);
+                    if (timer.missedTicks == MissedTicks::CatchUp)
+                    {
+                        due.ticks += missed;
+                    }
+                    auto next = entry.deadline + timer.interval * (missed + 1);
+                    m_timerHeap.push_back({next, next + timer.slack, entry.slot, entry.generation});
+                    std::push_heap(m_timerHeap.begin(), m_timerHeap.end(), laterDeadline);
+                }
+                m_dueTimers.push_back(std::move(due));
+            }
+        }
+
+        if (m_dueTimers.empty())
+        {
+            return false;
+        }
+        m_timerWakeups.fetch_add(1, std::memory_order_relaxed);
+
+        for (auto &due : m_dueTimers)
+        {
+            for (uint64_t i = 0; i < due.ticks && !isCancelled(due.task.cancelled); ++i)
+            {
+                // An earlier callback of this batch, or a caught-up tick,
+                // may have cancelled a periodic timer. One-shots gave up
+                // their slot when they were taken, so cancelTimer() already
+                // returned false for them.
+                if (due.periodic && !isTimerActive(due.slot, due.generation))
+                {
+                    break;
+                }
+                due.task.fn();
+                drainMicrotasks();
+                m_timersFired.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Hand periodic callables back to their slots, unless the timer
+        // was cancelled (and its slot possibly reused) while it ran.
+        {
+            std::lock_guard<Mutex> lock(m_timerMutex);
+            for (auto &due : m_dueTimers)
+            {
+                TimerSlot &timer = m_timerSlots[due.slot];
+                if (timer.active && timer.generation == due.generation)
+                {
+                    timer.fn = std::move(due.task.fn);
+                }
+            }
+        }
+        m_dueTimers.clear();
+        return true;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::addSource(int fd, std::function<void()> handler)
+    {
+        auto source = std::make_unique<Source>();
+        source->fn = std::move(handler);
+        changeSource(fd, std::move(source));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::addSharedSource(int fd, std::function<void()> handler)
+    {
+        auto source = std::make_unique<Source>();
+        source->fn = std::move(handler);
+        source->exclusive = true;
+        changeSource(fd, std::move(source));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::addReadSource(int fd, ReadHandler handler)
+    {
+        auto source = std::make_unique<Source>();
+        source->onRead = std::move(handler);
+        changeSource(fd, std::move(source));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::addSources(std::vector<std::pair<int, std::function<void()>>> sources)
+    {
+        std::vector<SourceCommand> commands;
+        commands.reserve(sources.size());
+        for (auto &[fd, handler] : sources)
+        {
+            auto source = std::make_unique<Source>();
+            source->fn = std::move(handler);
+            commands.push_back(SourceCommand{fd, SourceOp::Set, std::move(source)});
+        }
+
+        if (isOnLoopThread())
+        {
+            if (m_sourceCommandsPending.load(std::memory_order_acquire))
+            {
+                applySourceCommands();
+            }
+            for (auto &command : commands)
+            {
+                applySourceChange(command.fd, std::move(command.source), false);
+            }
+            return;
+        }
+        queueSourceCommands(std::move(commands));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::removeSource(int fd)
+    {
+        changeSource(fd, nullptr);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::changeSource(int fd, std::unique_ptr<Source> source)
+    {
+        if (isOnLoopThread())
+        {
+            // Queued commands are older: apply them first, so a stale
+            // removal cannot undo a new registration of the same fd number.
+            if (m_sourceCommandsPending.load(std::memory_order_acquire))
+            {
+                applySourceCommands();
+            }
+            applySourceChange(fd, std::move(source), false);
+            return;
+        }
+        if (source)
+        {
+            queueSourceCommand(fd, SourceOp::Set, std::move(source));
+            return;
+        }
+        // The caller may close the fd once this returns.
+        waitForSourceCommands(queueSourceCommand(fd, SourceOp::Remove));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::pauseSource(int fd)
+    {
+        if (isOnLoopThread())
+        {
+            applySourcePause(fd, true);
+            return;
+        }
+        queueSourceCommand(fd, SourceOp::Pause);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::resumeSource(int fd)
+    {
+        if (isOnLoopThread())
+        {
+            applySourcePause(fd, false);
+            return;
+        }
+        queueSourceCommand(fd, SourceOp::Resume);
+    }
+
+    template <typename Policy>
+    uint64_t BasicRunLoop<Policy>::queueSourceCommand(int fd, SourceOp op, std::unique_ptr<Source> source)
+    {
+        std::vector<SourceCommand> commands;
+        commands.push_back(SourceCommand{fd, op, std::move(source)});
+        return queueSourceCommands(std::move(commands));
+    }
+
+    template <typename Policy>
+    uint64_t BasicRunLoop<Policy>::queueSourceCommands(std::vector<SourceCommand> commands)
+    {
+        bool first = false;
+        uint64_t ticket = 0;
+        {
+            std::lock_guard<Mutex> lock(m_sourcesMutex);
+            first = m_sourceCommands.empty();
+            if (first)
+            {
+                m_sourceCommands = std::move(commands);
+            }
+            else
+            {
+                for (auto &command : commands)
+                {
+                    m_sourceCommands.push_back(std::move(command));
+                }
+            }
+            m_sourceCommandsPending.store(true, std::memory_order_seq_cst);
+            ticket = ++m_sourceCommandsQueued;
+        }
+        // Later commands ride on the wakeup of the first one.
+        if (first)
+        {
+            wakeup();
+        }
+        return ticket;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::waitForSourceCommands(uint64_t ticket)
+    {
+        if constexpr (Policy::kThreadSafe)
+        {
+            std::unique_lock<Mutex> lock(m_sourcesMutex);
+            m_sourceCommandsDone.wait(lock, [&] {
+                return m_sourceCommandsApplied >= ticket || !m_running.load(std::memory_order_acquire);
+            });
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::applySourceCommands()
+    {
+        std::vector<SourceCommand> commands;
+        uint64_t applied = 0;
+        {
+            std::lock_guard<Mutex> lock(m_sourcesMutex);
+            commands.swap(m_sourceCommands);
+            m_sourceCommandsPending.store(false, std::memory_order_relaxed);
+            applied = m_sourceCommandsQueued;
+        }
+
+        // Only the last command per fd matters, plus whether a removal
+        // came before it.
+        for (auto &command : commands)
+        {
+            PendingSource &pending = m_pendingSources[command.fd];
+            switch (command.op)
+            {
+            case SourceOp::Set:
+                pending.source = std::move(command.source);
+                pending.set = true;
+                pending.pauseChanged = false;
+                break;
+            case SourceOp::Remove:
+                pending.source.reset();
+                pending.set = false;
+                pending.removed = true;
+                pending.pauseChanged = false;
+                break;
+            case SourceOp::Pause:
+            case SourceOp::Resume:
+                pending.pauseChanged = true;
+                pending.paused = command.op == SourceOp::Pause;
+                break;
+            }
+        }
+        for (auto &[fd, pending] : m_pendingSources)
+        {
+            if (pending.set || pending.removed)
+            {
+                applySourceChange(fd, std::move(pending.source), pending.removed);
+            }
+            if (pending.pauseChanged)
+            {
+                applySourcePause(fd, pending.paused);
+            }
+        }
+        m_pendingSources.clear();
+
+        // Release removeSource() callers waiting on these commands.
+        if constexpr (Policy::kThreadSafe)
+        {
+            {
+                std::lock_guard<Mutex> lock(m_sourcesMutex);
+                m_sourceCommandsApplied = applied;
+            }
+            m_sourceCommandsDone.notify_all();
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::applySourceChange(int fd, std::unique_ptr<Source> source, bool removed)
+    {
+        auto it = m_sources.find(fd);
+        bool registered = it != m_sources.end();
+
+        if (!source)
+        {
+            if (registered)
+            {
+                epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                m_retiredSources.push_back(std::move(it->second));
+                m_sources.erase(it);
+                m_fdCount.fetch_sub(1, std::memory_order_seq_cst);
+            }
+            return;
+        }
+
+        struct epoll_event ev
+        {
+        };
+        ev.events = sourceEventMask(source->exclusive, true, false);
+        ev.data.u64 = eventData(EventKind::Source, fd);
+
+        if (!registered)
+        {
+            m_fdCount.fetch_add(1, std::memory_order_seq_cst);
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+            m_sources.emplace(fd, std::move(source));
+            return;
+        }
+
+        // Replacing a handler needs no syscall, unless the fd was removed
+        // in between: it may have been closed and its number reused, so
+        // refresh the registration (ENOENT = the old file is gone). A new
+        // handler starts unpaused and without write interest, so the
+        // interest may change too.
+        uint32_t before = sourceInterest(*it->second);
+        bool exclusive = it->second->exclusive || source->exclusive;
+        m_retiredSources.push_back(std::move(it->second));
+        it->second = std::move(source);
+        if (!removed)
+        {
+            updateSourceInterest(fd, *it->second, before);
+            return;
+        }
+        if (exclusive)
+        {
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        else if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev) != 0 && errno == ENOENT)
+        {
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::applySourcePause(int fd, bool paused)
+    {
+        auto it = m_sources.find(fd);
+        if (it == m_sources.end())
+        {
+            return;
+        }
+        Source &source = *it->second;
+        source.paused = paused;
+        // Pausing leaves the interest alone until the fd reports ready.
+        if (!paused && !source.armed)
+        {
+            setSourceInterest(fd, source, true);
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::dispatchReadSource(int fd, Source &source)
+    {
+        std::unique_ptr<char[]> buffer;
+        if (m_readBuffers.empty())
+        {
+            buffer = std::make_unique<char[]>(m_options.readBufferSize);
+            m_readBuffersAllocated.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            buffer = std::move(m_readBuffers.back());
+            m_readBuffers.pop_back();
+        }
+
+        ssize_t n;
+        do
+        {
+            n = read(fd, buffer.get(), m_options.readBufferSize);
+        } while (n < 0 && errno == EINTR);
+
+        // Spurious readiness: nothing to report.
+        if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            m_pooledReads.fetch_add(1, std::memory_order_relaxed);
+            source.onRead(buffer.get(), n < 0 ? -errno : n);
+        }
+        m_readBuffers.push_back(std::move(buffer));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::setSourceWritable(int fd, std::function<void()> handler)
+    {
+        auto it = m_sources.find(fd);
+        if (it == m_sources.end())
+        {
+            return;
+        }
+        Source &source = *it->second;
+        uint32_t before = sourceInterest(source);
+        source.onWritable = std::move(handler);
+        updateSourceInterest(fd, source, before);
+    }
+
+    template <typename Policy>
+    uint32_t BasicRunLoop<Policy>::sourceInterest(const Source &source)
+    {
+        return sourceEventMask(source.exclusive, source.armed, static_cast<bool>(source.onWritable));
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::setSourceInterest(int fd, Source &source, bool armed)
+    {
+        uint32_t before = sourceInterest(source);
+        source.armed = armed;
+        updateSourceInterest(fd, source, before);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::updateSourceInterest(int fd, Source &source, uint32_t before)
+    {
+        uint32_t after = sourceInterest(source);
+        if (after == before)
+        {
+            return;
+        }
+        struct epoll_event ev
+        {
+        };
+        ev.events = after;
+        ev.data.u64 = eventData(EventKind::Source, fd);
+        if (after == 0)
+        {
+            // Not MOD to an empty mask: epoll would keep reporting
+            // EPOLLHUP/EPOLLERR, spinning the loop on a hung-up fd.
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        else if (before == 0)
+        {
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        else if ((before | after) & EPOLLEXCLUSIVE)
+        {
+            // EPOLLEXCLUSIVE registrations cannot be modified in place.
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        else
+        {
+            epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::addSignal(int signo, std::function<void(int)> handler)
+    {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, signo);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+        dispatch(
+            [this, signo, set, handler = std::move(handler)]() mutable {
+                pthread_sigmask(SIG_BLOCK, &set, nullptr);
+                m_signalHandlers[signo] = std::move(handler);
+                updateSignalFd();
+            },
+            Priority::High);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::removeSignal(int signo)
+    {
+        dispatch(
+            [this, signo] {
+                if (m_signalHandlers.erase(signo) != 0)
+                {
+                    updateSignalFd();
+                }
+            },
+            Priority::High);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::updateSignalFd()
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for (const auto &entry : m_signalHandlers)
+        {
+            sigaddset(&mask, entry.first);
+        }
+
+        // signalfd() on an existing fd just swaps its mask.
+        if (m_signalFd >= 0)
+        {
+            signalfd(m_signalFd, &mask, 0);
+            return;
+        }
+        m_signalFd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+        if (m_signalFd < 0)
+        {
+            return;
+        }
+        struct epoll_event ev
+        {
+        };
+        ev.events = EPOLLIN;
+        ev.data.u64 = eventData(EventKind::Signal, m_signalFd);
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_signalFd, &ev);
+        m_fdCount.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::dispatchSignals()
+    {
+        // Drain everything first so repeats of one signal collapse into a
+        // single call.
+        std::vector<int> pending;
+        signalfd_siginfo info[8];
+        for (;;)
+        {
+            ssize_t n = read(m_signalFd, info, sizeof(info));
+            if (n <= 0)
+            {
+                break;
+            }
+            for (size_t i = 0; i < static_cast<size_t>(n) / sizeof(signalfd_siginfo); ++i)
+            {
+                int signo = static_cast<int>(info[i].ssi_signo);
+                if (std::find(pending.begin(), pending.end(), signo) == pending.end())
+                {
+                    pending.push_back(signo);
+                }
+            }
+        }
+
+        for (int signo : pending)
+        {
+            auto it = m_signalHandlers.find(signo);
+            if (it != m_signalHandlers.end() && it->second)
+            {
+                // Copied: the handler may remove or replace itself.
+                auto handler = it->second;
+                handler(signo);
+                drainMicrotasks();
+            }
+        }
+    }
+
+    template <typename Policy>
+    RunLoopBase::WatchId BasicRunLoop<Policy>::addWatch(const std::string &path, uint32_t events,
+                                                        WatchHandler handler)
+    {
+        int fd;
+        bool created = false;
+        {
+            std::lock_guard<Mutex> lock(m_sourcesMutex);
+            if (m_inotifyFd < 0)
+            {
+                m_inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+                if (m_inotifyFd < 0)
+                {
+                    return -1;
+                }
+                struct epoll_event ev
+                {
+                };
+                ev.events = EPOLLIN;
+                ev.data.u64 = eventData(EventKind::Watch, m_inotifyFd);
+                epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_inotifyFd, &ev);
+                m_fdCount.fetch_add(1, std::memory_order_seq_cst);
+                created = true;
+            }
+            fd = m_inotifyFd;
+        }
+        if (created)
+        {
+            wakeParked();
+        }
+
+        int wd = inotify_add_watch(fd, path.c_str(), events);
+        if (wd < 0)
+        {
+            return -1;
+        }
+        dispatch([this, wd, handler = std::move(handler)]() mutable { m_watchHandlers[wd] = std::move(handler); },
+                 Priority::High);
+        return wd;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::removeWatch(WatchId id)
+    {
+        int fd;
+        {
+            std::lock_guard<Mutex> lock(m_sourcesMutex);
+            fd = m_inotifyFd;
+        }
+        if (fd < 0)
+        {
+            return;
+        }
+        // Handler first, so the IN_IGNORED the kernel answers with finds
+        // nothing to call.
+        dispatch(
+            [this, fd, id] {
+                m_watchHandlers.erase(id);
+                inotify_rm_watch(fd, id);
+            },
+            Priority::High);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::dispatchWatches(int fd)
+    {
+        // Read everything queued, merging events per (watch, name) so a
+        // burst of modifications becomes one call.
+        alignas(inotify_event) char buffer[4096];
+        m_watchEvents.clear();
+        for (;;)
+        {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0)
+            {
+                break;
+            }
+            for (ssize_t offset = 0; offset < n;)
+            {
+                const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+                const char *name = event->len > 0 ? event->name : "";
+                auto it = std::find_if(m_watchEvents.begin(), m_watchEvents.end(), [&](const WatchEvent &e) {
+                    return e.wd == event->wd && e.name == name;
+                });
+                if (it != m_watchEvents.end())
+                {
+                    it->events |= event->mask;
+                }
+                else
+                {
+                    m_watchEvents.push_back(WatchEvent{event->wd, event->mask, name});
+                }
+            }
+        }
+
+        for (const auto &event : m_watchEvents)
+        {
+            auto it = m_watchHandlers.find(event.wd);
+            if (it == m_watchHandlers.end())
+            {
+                continue;
+            }
+            // Copied: the handler may remove or replace its own watch.
+            auto handler = it->second;
+            if (event.events & IN_IGNORED)
+            {
+                m_watchHandlers.erase(event.wd);
+            }
+            if (handler)
+            {
+                handler(event.events, event.name);
+                drainMicrotasks();
+            }
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::waitReadable(int fd, std::function<void()> fn)
+    {
+        std::lock_guard<Mutex> lock(m_sourcesMutex);
+        IoWait &wait = m_ioWaits[fd];
+        wait.onReadable = std::move(fn);
+        bool added = !wait.registered;
+        if (added)
+        {
+            m_fdCount.fetch_add(1, std::memory_order_seq_cst);
+        }
+        armIoWait(fd, wait);
+        if (added)
+        {
+            wakeParked();
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::waitWritable(int fd, std::function<void()> fn)
+    {
+        std::lock_guard<Mutex> lock(m_sourcesMutex);
+        IoWait &wait = m_ioWaits[fd];
+        wait.onWritable = std::move(fn);
+        bool added = !wait.registered;
+        if (added)
+        {
+            m_fdCount.fetch_add(1, std::memory_order_seq_cst);
+        }
+        armIoWait(fd, wait);
+        if (added)
+        {
+            wakeParked();
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::cancelWaits(int fd)
+    {
+        IoWait wait;
+        {
+            std::lock_guard<Mutex> lock(m_sourcesMutex);
+            auto it = m_ioWaits.find(fd);
+            if (it == m_ioWaits.end())
+            {
+                return;
+            }
+            wait = std::move(it->second);
+            m_ioWaits.erase(it);
+            m_fdCount.fetch_sub(1, std::memory_order_seq_cst);
+            if (wait.registered)
+            {
+                epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            }
+        }
+        // Dropped waiters are destroyed outside the lock.
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::armIoWait(int fd, IoWait &wait)
+    {
+        struct epoll_event ev
+        {
+        };
+        ev.events = EPOLLONESHOT;
+        if (wait.onReadable)
+        {
+            ev.events |= EPOLLIN;
+        }
+        if (wait.onWritable)
+        {
+            ev.events |= EPOLLOUT;
+        }
+        ev.data.u64 = eventData(EventKind::IoWait, fd);
+
+        // After the first wait the fd stays in the epoll set, disabled by
+        // EPOLLONESHOT, so re-arming is a single MOD. If the fd was closed
+        // (and its number reused) in between, the kernel already dropped
+        // it and MOD fails with ENOENT; fall back to ADD.
+        int op = wait.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (epoll_ctl(m_epollFd, op, fd, &ev) != 0)
+        {
+            op = errno == ENOENT ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            epoll_ctl(m_epollFd, op, fd, &ev);
+        }
+        wait.registered = true;
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::dispatchIoWait(int fd, uint32_t events)
+    {
+        std::function<void()> onReadable;
+        std::function<void()> onWritable;
+        {
+            std::lock_guard<Mutex> lock(m_sourcesMutex);
+            auto it = m_ioWaits.find(fd);
+            if (it == m_ioWaits.end())
+            {
+                return;
+            }
+            IoWait &wait = it->second;
+
+            // Errors and hang-ups complete both directions; the retried
+            // syscall reports what actually happened.
+            constexpr uint32_t failed = EPOLLERR | EPOLLHUP;
+            if (events & (EPOLLIN | failed))
+            {
+                onReadable.swap(wait.onReadable);
+            }
+            if (events & (EPOLLOUT | failed))
+            {
+                onWritable.swap(wait.onWritable);
+            }
+
+            // EPOLLONESHOT disarmed the whole fd; re-arm what still waits.
+            if (wait.onReadable || wait.onWritable)
+            {
+                armIoWait(fd, wait);
+            }
+        }
+
+        if (onReadable)
+        {
+            onReadable();
+        }
+        if (onWritable)
+        {
+            onWritable();
+        }
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::wakeup()
+    {
+        if (isOnLoopThread())
+        {
+            m_wakeupPending = true;
+            return;
+        }
+        if (Policy::kThreadSafe && m_options.parkOnFutex)
+        {
+            // Pairs with the fence in waitOrPark(): either the loop sees
+            // this thread's work before blocking, or this thread sees
+            // that the loop is blocked.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            switch (m_waitState.load(std::memory_order_seq_cst))
+            {
+            case kRunning:
+                return;
+            case kParked:
+                wakeParked();
+                return;
+            default:
+                break;
+            }
+        }
+        char byte = 1;
+        [[maybe_unused]] auto r = write(m_wakeupFd[1], &byte, 1);
+    }
+
+    template <typename Policy>
+    void BasicRunLoop<Policy>::wakeParked()
+    {
+        if (Policy::kThreadSafe && m_options.parkOnFutex &&
+            m_waitState.load(std::memory_order_seq_cst) == kParked)
+        {
+            m_futexWord.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, futexAddress(m_futexWord), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+        }
+    }
+
+    template class BasicRunLoop<ThreadSafePolicy>;
+    template class BasicRunLoop<SingleThreadPolicy>;
+
 } // namespace ms
@@ -0,0 +1,261 @@
+#include "StreamConnection.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ms
+{
+
+    namespace
+    {
+        // iovecs per write; more output is written by the next call.
+        constexpr int kMaxIovecs = 64;
+    } // namespace
+
+    StreamConnection::~StreamConnection()
+    {
+        close();
+    }
+
+    bool StreamConnection::setup(int fd, DataHandler onData, CloseHandler onClose, const Options &options)
+    {
+        int type = 0;
+        socklen_t length = sizeof(type);
+        if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) != 0)
+        {
+            return false;
+        }
+        if (type != SOCK_STREAM)
+        {
+            errno = EPROTOTYPE;
+            return false;
+        }
+
+        m_fd = fd;
+        m_options = options;
+        m_options.chunkSize = std::max<size_t>(m_options.chunkSize, 1);
+        m_onData = std::move(onData);
+        m_onClose = std::move(onClose);
+
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && !(flags & O_NONBLOCK))
+        {
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        return true;
+    }
+
+    void StreamConnection::send(const void *data, size_t size)
+    {
+        if (m_fd < 0 || size == 0)
+        {
+            return;
+        }
+        ++m_stats.sends;
+
+        // Append to the last link while it has room, then start new ones.
+        const char *bytes = static_cast<const char *>(data);
+        m_outputSize += size;
+        while (size > 0)
+        {
+            if (m_output.empty() || m_output.back().size() >= m_options.chunkSize)
+            {
+                if (m_spareChunks.empty())
+                {
+                    m_output.emplace_back();
+                    m_output.back().reserve(m_options.chunkSize);
+                }
+                else
+                {
+                    m_output.push_back(std::move(m_spareChunks.back()));
+                    m_spareChunks.pop_back();
+                }
+            }
+            std::vector<char> &chunk = m_output.back();
+            size_t n = std::min(size, m_options.chunkSize - chunk.size());
+            chunk.insert(chunk.end(), bytes, bytes + n);
+            bytes += n;
+            size -= n;
+        }
+
+        if (m_outputSize >= m_options.flushThreshold)
+        {
+            writeOut();
+            return;
+        }
+        scheduleFlush();
+    }
+
+    void StreamConnection::flush()
+    {
+        if (m_fd >= 0)
+        {
+            writeOut();
+        }
+    }
+
+    void StreamConnection::uncork()
+    {
+        m_corked = false;
+        flush();
+    }
+
+    void StreamConnection::close()
+    {
+        if (m_fd < 0)
+        {
+            return;
+        }
+        m_alive.cancel();
+        if (m_detach)
+        {
+            m_detach();
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        m_output.clear();
+        m_spareChunks.clear();
+        m_outputSize = 0;
+        m_outputOffset = 0;
+        m_input.clear();
+        m_input.shrink_to_fit();
+    }
+
+    void StreamConnection::scheduleFlush()
+    {
+        // Writable interest flushes by itself; a held cork waits for uncork().
+        if (m_flushScheduled || m_waitingWritable || m_corked)
+        {
+            return;
+        }
+        m_flushScheduled = true;
+        m_post();
+    }
+
+    bool StreamConnection::writeOut()
+    {
+        while (m_outputSize > 0)
+        {
+            iovec iov[kMaxIovecs];
+            int count = 0;
+            size_t total = 0;
+            size_t offset = m_outputOffset;
+            for (auto it = m_output.begin(); it != m_output.end() && count < kMaxIovecs; ++it, ++count)
+            {
+                iov[count].iov_base = it->data() + offset;
+                iov[count].iov_len = it->size() - offset;
+                total += iov[count].iov_len;
+                offset = 0;
+            }
+
+            // sendmsg() is writev() plus flags: MSG_NOSIGNAL turns a
+            // vanished peer into EPIPE instead of SIGPIPE.
+            msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = static_cast<size_t>(count);
+            ssize_t n = sendmsg(m_fd, &message, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+                fail(-errno);
+                return false;
+            }
+            ++m_stats.writes;
+            m_stats.bytesWritten += static_cast<uint64_t>(n);
+
+            // Drop what was written; emptied links are kept for reuse.
+            size_t written = static_cast<size_t>(n);
+            m_outputSize -= written;
+            while (written > 0)
+            {
+                size_t left = m_output.front().size() - m_outputOffset;
+                if (written < left)
+                {
+                    m_outputOffset += written;
+                    break;
+                }
+                written -= left;
+                m_outputOffset = 0;
+                m_output.front().clear();
+                m_spareChunks.push_back(std::move(m_output.front()));
+                m_output.pop_front();
+            }
+            if (m_spareChunks.size() > 4)
+            {
+                m_spareChunks.resize(4);
+            }
+            if (static_cast<size_t>(n) < total)
+            {
+                break; // the socket buffer is full
+            }
+        }
+
+        bool pending = m_outputSize > 0;
+        if (pending)
+        {
+            ++m_stats.stalls;
+        }
+        if (pending != m_waitingWritable)
+        {
+            m_waitingWritable = pending;
+            m_watchWritable(pending);
+        }
+        return true;
+    }
+
+    void StreamConnection::readReady(const char *data, ssize_t result)
+    {
+        if (result <= 0)
+        {
+            fail(static_cast<int>(result));
+            return;
+        }
+        m_stats.bytesRead += static_cast<uint64_t>(result);
+        size_t size = static_cast<size_t>(result);
+
+        // The handler may close or destroy the connection.
+        CancelToken alive = m_alive;
+        if (m_input.empty())
+        {
+            // Common case: consume straight from the loop's read buffer and
+            // copy only a partial frame.
+            size_t consumed = std::min(m_onData(data, size), size);
+            if (!alive.isCancelled() && consumed < size)
+            {
+                m_input.assign(data + consumed, data + size);
+            }
+            return;
+        }
+
+        m_input.insert(m_input.end(), data, data + size);
+        size_t consumed = std::min(m_onData(m_input.data(), m_input.size()), m_input.size());
+        if (!alive.isCancelled())
+        {
+            m_input.erase(m_input.begin(), m_input.begin() + static_cast<std::ptrdiff_t>(consumed));
+        }
+    }
+
+    void StreamConnection::fail(int error)
+    {
+        CloseHandler onClose = std::move(m_onClose);
+        m_onClose = nullptr;
+        close();
+        if (onClose)
+        {
+            onClose(error);
+        }
+    }
+
+} // namespace ms
@@ -0,0 +1,115 @@
+#include "Task.h"
+
+#include <cerrno>
+#include <new>
+
+#include <unistd.h>
+
+namespace ms::detail
+{
+
+    namespace
+    {
+        constexpr size_t kFrameGranularity = 64;
+        constexpr size_t kFrameClasses = 16; // frames up to 1 KiB are pooled
+        constexpr size_t kMaxPooledPerClass = 64;
+
+        struct FreeFrame
+        {
+            FreeFrame *next;
+        };
+
+        // Per-thread free lists, one per size class. A frame freed on a
+        // different thread than it was allocated on simply joins that
+        // thread's list; the cap keeps lopsided producer/consumer pairs
+        // from hoarding memory.
+        struct FramePool
+        {
+            FreeFrame *heads[kFrameClasses] = {};
+            size_t sizes[kFrameClasses] = {};
+
+            ~FramePool()
+            {
+                for (auto *head : heads)
+                {
+                    while (head)
+                    {
+                        FreeFrame *next = head->next;
+                        ::operator delete(head);
+                        head = next;
+                    }
+                }
+            }
+        };
+
+        thread_local FramePool t_framePool;
+
+        size_t frameClass(size_t size)
+        {
+            return (size + kFrameGranularity - 1) / kFrameGranularity - 1;
+        }
+    } // namespace
+
+    void *allocateFrame(size_t size)
+    {
+        size_t cls = frameClass(size);
+        if (cls >= kFrameClasses)
+        {
+            return ::operator new(size);
+        }
+
+        FramePool &pool = t_framePool;
+        if (FreeFrame *frame = pool.heads[cls])
+        {
+            pool.heads[cls] = frame->next;
+            --pool.sizes[cls];
+            return frame;
+        }
+        return ::operator new((cls + 1) * kFrameGranularity);
+    }
+
+    void deallocateFrame(void *frame, size_t size) noexcept
+    {
+        size_t cls = frameClass(size);
+        if (cls >= kFrameClasses)
+        {
+            ::operator delete(frame);
+            return;
+        }
+
+        FramePool &pool = t_framePool;
+        if (pool.sizes[cls] >= kMaxPooledPerClass)
+        {
+            ::operator delete(frame);
+            return;
+        }
+        auto *node = static_cast<FreeFrame *>(frame);
+        node->next = pool.heads[cls];
+        pool.heads[cls] = node;
+        ++pool.sizes[cls];
+    }
+
+    bool IoOperation::attempt()
+    {
+        for (;;)
+        {
+            ssize_t n = m_op == Op::Read ? ::read(m_fd, m_buf, m_len) : ::write(m_fd, m_buf, m_len);
+            if (n >= 0)
+            {
+                m_result = n;
+                return true;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return false;
+            }
+            m_result = -errno;
+            return true;
+        }
+    }
+
+} // namespace ms::detail
@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+#include "Acceptor.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace ms;
+using namespace std::chrono_literals;
+
+namespace
+{
+    struct RunLoopGuard
+    {
+        RunLoop &loop;
+        std::thread thread;
+
+        explicit RunLoopGuard(RunLoop &l) : loop(l), thread([&l] { l.run(); }) {}
+
+        ~RunLoopGuard()
+        {
+            loop.stop();
+            if (thread.joinable())
+                thread.join();
+        }
+    };
+
+    sockaddr_in loopback(uint16_t port)
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return address;
+    }
+
+    // Blocking connect; the kernel completes it from the backlog before
+    // the server accepts.
+    int connectTo(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address = loopback(port);
+        if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+} // namespace
+
+// ═════════════════════════════════════════════════════════════════════
+// One readiness event accepts up to the budget; the rest follow on the
+// next iterations.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(AcceptorTest, DrainsQueueUpToBudget)
+{
+    RunLoop loop;
+    loop.init("Acceptor");
+
+    std::atomic<int> accepted{0};
+    std::vector<int> clients;
+    Acceptor acceptor;
+    Acceptor::Options options;
+    options.acceptBudget = 4;
+    sockaddr_in address = loopback(0);
+    ASSERT_TRUE(acceptor.listen(
+        loop, reinterpret_cast<const sockaddr *>(&address), sizeof(address),
+        [&](int fd) {
+            EXPECT_TRUE(fcntl(fd, F_GETFL) & O_NONBLOCK);
+            close(fd);
+            accepted.fetch_add(1);
+        },
+        options));
+    ASSERT_NE(acceptor.port(), 0);
+
+    // Queue ten connections before the loop runs.
+    for (int i = 0; i < 10; ++i)
+    {
+        int fd = connectTo(acceptor.port());
+        ASSERT_GE(fd, 0);
+        clients.push_back(fd);
+    }
+
+    {
+        RunLoopGuard guard(loop);
+        for (int i = 0; i < 200 && accepted.load() < 10; ++i)
+            std::this_thread::sleep_for(5ms);
+        EXPECT_EQ(accepted.load(), 10);
+
+        auto stats = loop.executeAndWait([&] { return acceptor.stats(); });
+        EXPECT_EQ(stats.accepted, 10u);
+        EXPECT_GE(stats.readyEvents, 3u); // 4 + 4 + 2
+        EXPECT_LE(stats.readyEvents, 4u);
+    }
+
+    for (int fd : clients)
+        close(fd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// AcceptorGroup: every loop owns a SO_REUSEPORT listener on one port and
+// the kernel spreads connections across them.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(AcceptorTest, ReusePortGroupSpreadsConnections)
+{
+    constexpr size_t kLoops = 3;
+    constexpr int kClients = 60;
+
+    std::vector<std::unique_ptr<RunLoop>> loops;
+    std::vector<RunLoop *> loopPtrs;
+    for (size_t i = 0; i < kLoops; ++i)
+    {
+        loops.push_back(std::make_unique<RunLoop>());
+        loops.back()->init("AcceptorGroup");
+        loopPtrs.push_back(loops.back().get());
+    }
+
+    std::mutex mutex;
+    std::set<size_t> usedLoops;
+    std::atomic<int> accepted{0};
+    AcceptorGroup group;
+    sockaddr_in address = loopback(0);
+    ASSERT_TRUE(group.listen(loopPtrs, reinterpret_cast<const sockaddr *>(&address), sizeof(address),
+                             [&](size_t loop, int fd) {
+                                 EXPECT_TRUE(loops[loop]->isOnLoopThread());
+                                 close(fd);
+                                 {
+                                     std::lock_guard<std::mutex> lock(mutex);
+                                     usedLoops.insert(loop);
+                                 }
+                                 accepted.fetch_add(1);
+                             }));
+    ASSERT_EQ(group.size(), kLoops);
+    for (size_t i = 0; i < kLoops; ++i)
+        EXPECT_EQ(group.acceptor(i).port(), group.port());
+
+    std::vector<std::unique_ptr<RunLoopGuard>> guards;
+    for (auto &loop : loops)
+        guards.push_back(std::make_unique<RunLoopGuard>(*loop));
+
+    for (int i = 0; i < kClients; ++i)
+    {
+        int fd = connectTo(group.port());
+        ASSERT_GE(fd, 0);
+        close(fd);
+    }
+    for (int i = 0; i < 200 && accepted.load() < kClients; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(accepted.load(), kClients);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_GT(usedLoops.size(), 1u);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A listener that cannot be set up fails the whole group before any
+// running loop has been handed a source.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(AcceptorTest, GroupFailureRegistersNothing)
+{
+    RunLoop first;
+    first.init("AcceptorGroupFail0");
+    RunLoop second;
+    second.init("AcceptorGroupFail1");
+    std::vector<RunLoop *> loops{&first, &second};
+    std::atomic<int> accepted{0};
+    AcceptorGroup group; // outlives the running loops
+    RunLoopGuard firstGuard(first);
+    RunLoopGuard secondGuard(second);
+
+    // Leave room for exactly one listener (socket plus spare fd), so the
+    // second socket() fails with EMFILE.
+    int a = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int b = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(a, 0);
+    ASSERT_GE(b, 0);
+    close(a);
+    close(b);
+    rlimit saved;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &saved), 0);
+    rlimit limited = saved;
+    limited.rlim_cur = static_cast<rlim_t>(b + 1);
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limited), 0);
+
+    sockaddr_in address = loopback(0);
+    bool listening = group.listen(loops, reinterpret_cast<const sockaddr *>(&address), sizeof(address),
+                                  [](size_t, int fd) { close(fd); });
+    int error = errno;
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &saved), 0);
+
+    EXPECT_FALSE(listening);
+    EXPECT_EQ(error, EMFILE);
+    EXPECT_EQ(group.size(), 0u);
+
+    // The first listener's fds were released as well.
+    int c = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    EXPECT_EQ(c, a);
+    close(c);
+
+    // With fds to spare the same group listens on both loops.
+    ASSERT_TRUE(group.listen(loops, reinterpret_cast<const sockaddr *>(&address), sizeof(address),
+                             [&](size_t, int fd) {
+                                 close(fd);
+                                 accepted.fetch_add(1);
+                             }));
+    EXPECT_EQ(group.size(), 2u);
+    int client = connectTo(group.port());
+    ASSERT_GE(client, 0);
+    for (int i = 0; i < 200 && accepted.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(accepted.load(), 1);
+    close(client);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Out of fds with no spare to shed connections: the listener is paused
+// and retried instead of spinning, and accepts again once fds free up.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(AcceptorTest, BacksOffWithoutSpareFd)
+{
+    RunLoop loop;
+    loop.init("AcceptorBackoff");
+
+    // Client sockets exist before the limit; connect() needs no new fd.
+    constexpr int kClients = 3;
+    std::vector<int> clients;
+    for (int i = 0; i < kClients; ++i)
+        clients.push_back(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+
+    // Room for the listener only: its spare cannot be opened.
+    int lowest = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(lowest, 0);
+    close(lowest);
+    rlimit saved;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &saved), 0);
+    rlimit limited = saved;
+    limited.rlim_cur = static_cast<rlim_t>(lowest + 1);
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limited), 0);
+
+    std::atomic<int> accepted{0};
+    Acceptor acceptor;
+    Acceptor::Options options;
+    options.fdRetryDelay = 20ms;
+    sockaddr_in address = loopback(0);
+    bool listening = acceptor.listen(
+        loop, reinterpret_cast<const sockaddr *>(&address), sizeof(address),
+        [&](int fd) {
+            close(fd);
+            accepted.fetch_add(1);
+        },
+        options);
+    if (!listening)
+        setrlimit(RLIMIT_NOFILE, &saved);
+    ASSERT_TRUE(listening);
+
+    sockaddr_in server = loopback(acceptor.port());
+    for (int fd : clients)
+        EXPECT_EQ(connect(fd, reinterpret_cast<const sockaddr *>(&server), sizeof(server)), 0);
+
+    {
+        RunLoopGuard guard(loop);
+        std::this_thread::sleep_for(100ms);
+        auto stats = loop.executeAndWait([&] { return acceptor.stats(); });
+        EXPECT_EQ(stats.accepted, 0u);
+        EXPECT_GE(stats.backoffs, 1u);
+        // One wakeup per retry, not a spinning listener.
+        EXPECT_LE(stats.readyEvents, 10u);
+
+        ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &saved), 0);
+        for (int i = 0; i < 200 && accepted.load() < kClients; ++i)
+            std::this_thread::sleep_for(5ms);
+        EXPECT_EQ(accepted.load(), kClients);
+    }
+
+    for (int fd : clients)
+        close(fd);
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include "Future.h"
+#include "RunLoop.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ms;
+using namespace std::chrono_literals;
+
+// Helper: run loop in background, auto-stop on scope exit.
+struct RunLoopGuard
+{
+    RunLoop &loop;
+    std::thread thread;
+
+    explicit RunLoopGuard(RunLoop &l) : loop(l), thread([&l] { l.run(); }) {}
+
+    ~RunLoopGuard()
+    {
+        loop.stop();
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+// ═════════════════════════════════════════════════════════════════════
+// A value set on the promise is returned by get().
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, SetValue)
+{
+    Promise<std::string> promise;
+    auto future = promise.future();
+
+    EXPECT_TRUE(future.valid());
+    EXPECT_FALSE(future.isReady());
+
+    promise.setValue("hello");
+
+    EXPECT_TRUE(future.isReady());
+    EXPECT_EQ(future.get(), "hello");
+    EXPECT_FALSE(future.valid());
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// get() blocks until another thread sets the value.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, GetBlocksUntilSet)
+{
+    Promise<void> promise;
+    auto future = promise.future();
+
+    EXPECT_FALSE(future.waitFor(10ms));
+
+    std::thread t([promise]() mutable {
+        std::this_thread::sleep_for(10ms);
+        promise.setValue();
+    });
+
+    future.get();
+    t.join();
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Exceptions are rethrown by get().
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, ExceptionPropagates)
+{
+    Promise<int> promise;
+    auto future = promise.future();
+
+    auto fn = []() -> int { throw std::runtime_error("boom"); };
+    promise.setFrom(fn);
+
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Destroying every promise copy without a result breaks the promise.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, BrokenPromise)
+{
+    Future<int> future;
+    {
+        Promise<int> promise;
+        future = promise.future();
+        Promise<int> copy(promise);
+    }
+
+    EXPECT_TRUE(future.isReady());
+    EXPECT_THROW(future.get(), std::future_error);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// then() runs the continuation on the target loop.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, ThenRunsOnTargetLoop)
+{
+    RunLoop producer;
+    producer.init("Producer");
+    RunLoop consumer;
+    consumer.init("Consumer");
+
+    std::thread::id consumerThreadId;
+    consumer.executeOnRunLoop([&] { consumerThreadId = std::this_thread::get_id(); });
+
+    RunLoopGuard producerGuard(producer);
+    RunLoopGuard consumerGuard(consumer);
+
+    std::thread::id continuationThreadId;
+    auto result = producer.post([] { return 20; }).then(consumer, [&](int v) {
+        continuationThreadId = std::this_thread::get_id();
+        return v + 1;
+    });
+
+    EXPECT_EQ(result.get(), 21);
+    EXPECT_EQ(continuationThreadId, consumerThreadId);
+
+    // Move-only continuations are accepted.
+    auto owned = std::make_unique<int>(22);
+    auto moved = producer.post([] { return 1; }).then(consumer, [owned = std::move(owned)](int v) {
+        return *owned + v;
+    });
+    EXPECT_EQ(moved.get(), 23);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// then() on an already-ready future still posts to the target loop,
+// and exceptions skip the continuation.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, ThenPropagatesException)
+{
+    RunLoop loop;
+    loop.init("ThenError");
+    RunLoopGuard guard(loop);
+
+    Promise<int> promise;
+    auto future = promise.future();
+    promise.setException(std::make_exception_ptr(std::runtime_error("boom")));
+
+    std::atomic<bool> called{false};
+    auto next = future.then(loop, [&](int) { called.store(true); });
+
+    EXPECT_THROW(next.get(), std::runtime_error);
+    EXPECT_FALSE(called.load());
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A future completed on its target loop continues as a microtask, ahead
+// of callables already queued on that loop.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(FutureTest, ThenOnSameLoopRunsBeforeQueuedPosts)
+{
+    RunLoop loop;
+    loop.init("ThenLocal");
+    RunLoopGuard guard(loop);
+
+    std::vector<int> order;
+    Promise<int> promise;
+    auto next = promise.future().then(loop, [&](int v) { order.push_back(v); });
+
+    loop.executeAndWait([&] {
+        loop.executeOnRunLoop([&] { order.push_back(2); });
+        promise.setValue(1);
+    });
+    next.get();
+    loop.executeAndWait([] {});
+
+    ASSERT_EQ(order.size(), 2u);
+    EXPECT_EQ(order[0], 1);
+    EXPECT_EQ(order[1], 2);
+}
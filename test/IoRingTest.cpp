@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+#include "IoRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace ms;
+using namespace std::chrono_literals;
+
+namespace
+{
+    struct RunLoopGuard
+    {
+        RunLoop &loop;
+        std::thread thread;
+
+        explicit RunLoopGuard(RunLoop &l) : loop(l), thread([&l] { l.run(); }) {}
+
+        ~RunLoopGuard()
+        {
+            loop.stop();
+            if (thread.joinable())
+                thread.join();
+        }
+    };
+
+    // Unlinked temporary file.
+    int makeTempFile()
+    {
+        char path[] = "/tmp/ioring-test-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0)
+            unlink(path);
+        return fd;
+    }
+
+    template <typename Pred>
+    void waitFor(Pred pred)
+    {
+        for (int i = 0; i < 200 && !pred(); ++i)
+            std::this_thread::sleep_for(5ms);
+    }
+} // namespace
+
+// ═════════════════════════════════════════════════════════════════════
+// Writes and reads a file through registered buffers; operations queued
+// in one iteration go to the kernel with a single submit.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(IoRingTest, FileReadWriteFixed)
+{
+    RunLoop loop;
+    loop.init("IoRingFile");
+
+    IoRing ring;
+    IoRing::Options options;
+    options.bufferCount = 4;
+    options.bufferSize = 4096;
+    if (!ring.init(loop, options))
+        GTEST_SKIP() << "io_uring not available";
+
+    int fd = makeTempFile();
+    ASSERT_GE(fd, 0);
+
+    RunLoopGuard guard(loop);
+
+    std::atomic<int> written{0};
+    std::atomic<std::thread::id> completionThread{};
+    loop.executeAndWait([&] {
+        for (int i = 0; i < 4; ++i)
+        {
+            int buffer = ring.acquireBuffer();
+            ASSERT_GE(buffer, 0);
+            std::memset(ring.bufferData(buffer), 'a' + i, 4096);
+            ASSERT_TRUE(ring.writeFixed(fd, buffer, 4096, static_cast<uint64_t>(i) * 4096, [&, buffer](int result) {
+                EXPECT_EQ(result, 4096);
+                completionThread.store(std::this_thread::get_id());
+                ring.releaseBuffer(buffer);
+                written.fetch_add(1);
+            }));
+        }
+        EXPECT_EQ(ring.acquireBuffer(), -1);
+    });
+    waitFor([&] { return written.load() == 4; });
+    ASSERT_EQ(written.load(), 4);
+    EXPECT_NE(completionThread.load(), std::this_thread::get_id());
+
+    auto stats = loop.executeAndWait([&] { return ring.stats(); });
+    EXPECT_EQ(stats.submitted, 4u);
+    EXPECT_EQ(stats.submitCalls, 1u);
+    EXPECT_EQ(stats.completed, 4u);
+
+    // Read the third block back into a registered buffer.
+    std::atomic<bool> read{false};
+    std::string block;
+    loop.executeAndWait([&] {
+        int buffer = ring.acquireBuffer();
+        ASSERT_TRUE(ring.registerFile(fd));
+        ring.readFixed(fd, buffer, 4096, 2 * 4096, [&, buffer](int result) {
+            if (result > 0)
+                block.assign(ring.bufferData(buffer), static_cast<size_t>(result));
+            ring.releaseBuffer(buffer);
+            read.store(true);
+        });
+    });
+    waitFor([&] { return read.load(); });
+    ASSERT_TRUE(read.load());
+    EXPECT_EQ(block, std::string(4096, 'c'));
+
+    loop.executeAndWait([&] { ring.unregisterFile(fd); });
+    close(fd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Pipes use the current position; a pending read completes when data
+// arrives, and errors come back as -errno.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(IoRingTest, PipeReadCompletesOnData)
+{
+    RunLoop loop;
+    loop.init("IoRingPipe");
+
+    IoRing ring;
+    if (!ring.init(loop))
+        GTEST_SKIP() << "io_uring not available";
+
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_CLOEXEC), 0);
+
+    RunLoopGuard guard(loop);
+
+    std::atomic<int> result{1};
+    std::string data;
+    loop.executeAndWait([&] {
+        int buffer = ring.acquireBuffer();
+        ring.readFixed(fds[0], buffer, ring.bufferSize(), IoRing::kCurrentPosition, [&, buffer](int n) {
+            if (n > 0)
+                data.assign(ring.bufferData(buffer), static_cast<size_t>(n));
+            ring.releaseBuffer(buffer);
+            result.store(n);
+        });
+    });
+
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(result.load(), 1); // still pending
+    ASSERT_EQ(write(fds[1], "hello", 5), 5);
+    waitFor([&] { return result.load() != 1; });
+    EXPECT_EQ(result.load(), 5);
+    EXPECT_EQ(data, "hello");
+
+    // Writing to the read end fails with -EBADF.
+    std::atomic<int> error{0};
+    loop.executeAndWait([&] {
+        int buffer = ring.acquireBuffer();
+        ring.writeFixed(fds[0], buffer, 1, IoRing::kCurrentPosition, [&, buffer](int n) {
+            ring.releaseBuffer(buffer);
+            error.store(n);
+        });
+    });
+    waitFor([&] { return error.load() != 0; });
+    EXPECT_EQ(error.load(), -EBADF);
+
+    // Indexes outside the registered buffers are refused up front.
+    loop.executeAndWait([&] {
+        EXPECT_FALSE(ring.readFixed(fds[0], -1, 1, IoRing::kCurrentPosition, nullptr));
+        EXPECT_FALSE(ring.readFixed(fds[0], static_cast<int>(IoRing::Options().bufferCount), 1,
+                                    IoRing::kCurrentPosition, nullptr));
+    });
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A ring destroyed inside a posted callable is gone for the rest of that
+// iteration: its BeforeWait observer must not run on the freed object.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(IoRingTest, DestroyOnLoopThread)
+{
+    RunLoop loop;
+    loop.init("IoRingDestroy");
+
+    auto ring = std::make_unique<IoRing>();
+    if (!ring->init(loop))
+        GTEST_SKIP() << "io_uring not available";
+
+    RunLoopGuard guard(loop);
+    loop.executeAndWait([&] { EXPECT_GE(ring->acquireBuffer(), 0); });
+
+    // Posts run before BeforeWait in the same iteration.
+    loop.executeAndWait([&] { ring.reset(); });
+    for (int i = 0; i < 3; ++i)
+        loop.executeAndWait([] {});
+    EXPECT_EQ(ring, nullptr);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A completion may destroy its own ring; reaping stops there instead of
+// touching the freed queues.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(IoRingTest, CompletionDestroysRing)
+{
+    RunLoop loop;
+    loop.init("IoRingSelfDestroy");
+
+    auto ring = std::make_unique<IoRing>();
+    if (!ring->init(loop))
+        GTEST_SKIP() << "io_uring not available";
+
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_CLOEXEC), 0);
+
+    RunLoopGuard guard(loop);
+    std::atomic<int> calls{0};
+    loop.executeAndWait([&] {
+        for (int i = 0; i < 2; ++i)
+        {
+            ring->readFixed(fds[0], ring->acquireBuffer(), 1, IoRing::kCurrentPosition, [&](int) {
+                ring.reset();
+                calls.fetch_add(1);
+            });
+        }
+    });
+
+    // Both reads can complete in one reap; only the first runs.
+    ASSERT_EQ(write(fds[1], "ab", 2), 2);
+    waitFor([&] { return calls.load() != 0; });
+    loop.executeAndWait([] {});
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(ring, nullptr);
+
+    close(fds[0]);
+    close(fds[1]);
+}
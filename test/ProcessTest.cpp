@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include "Process.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ms;
+using namespace std::chrono_literals;
+
+namespace
+{
+    struct RunLoopGuard
+    {
+        RunLoop &loop;
+        std::thread thread;
+
+        explicit RunLoopGuard(RunLoop &l) : loop(l), thread([&l] { l.run(); }) {}
+
+        ~RunLoopGuard()
+        {
+            loop.stop();
+            if (thread.joinable())
+                thread.join();
+        }
+    };
+} // namespace
+
+// ═════════════════════════════════════════════════════════════════════
+// stdout and stderr are captured separately and fully delivered before
+// onExit reports the exit status.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(ProcessTest, CapturesOutputAndExitStatus)
+{
+    RunLoop loop;
+    loop.init("Spawn");
+    RunLoopGuard guard(loop);
+
+    std::mutex mutex;
+    std::string out;
+    std::string err;
+    std::atomic<bool> exited{false};
+    int status = -1;
+    size_t outAtExit = 0;
+
+    SpawnOptions options;
+    options.argv = {"sh", "-c", "echo hello; echo oops >&2; exit 3"};
+    options.onStdout = [&](const char *data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.append(data, size);
+    };
+    options.onStderr = [&](const char *data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        err.append(data, size);
+    };
+    options.onExit = [&](int s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        status = s;
+        outAtExit = out.size();
+        exited.store(true);
+    };
+    pid_t pid = spawnProcess(loop, std::move(options));
+    ASSERT_GT(pid, 0);
+
+    for (int i = 0; i < 400 && !exited.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    ASSERT_TRUE(exited.load());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(out, "hello\n");
+    EXPECT_EQ(err, "oops\n");
+    EXPECT_EQ(outAtExit, out.size());
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 3);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Many concurrent children are all reaped by the loop; a program that
+// does not exist fails to spawn with errno set.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(ProcessTest, ManyChildrenAndSpawnFailure)
+{
+    RunLoop loop;
+    loop.init("SpawnMany");
+    RunLoopGuard guard(loop);
+
+    constexpr int kChildren = 32;
+    std::atomic<int> exited{0};
+    std::atomic<int> bytes{0};
+    for (int i = 0; i < kChildren; ++i)
+    {
+        SpawnOptions options;
+        options.argv = {"echo", std::to_string(i)};
+        options.onStdout = [&](const char *, size_t size) { bytes.fetch_add(static_cast<int>(size)); };
+        options.onExit = [&](int status) {
+            EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+            exited.fetch_add(1);
+        };
+        ASSERT_GT(spawnProcess(loop, std::move(options)), 0);
+    }
+    for (int i = 0; i < 400 && exited.load() < kChildren; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(exited.load(), kChildren);
+    EXPECT_EQ(bytes.load(), 10 * 2 + 22 * 3); // "0\n".."9\n", "10\n".."31\n"
+
+    SpawnOptions missing;
+    missing.argv = {"/nonexistent/ms-runloop-test"};
+    missing.onExit = [](int) { FAIL() << "never started"; };
+    errno = 0;
+    EXPECT_EQ(spawnProcess(loop, std::move(missing)), -1);
+    EXPECT_EQ(errno, ENOENT);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A child spawned from the loop thread does not inherit the signals that
+// addSignal() blocked there, so it can still be signalled to death.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(ProcessTest, ChildDoesNotInheritBlockedSignals)
+{
+    RunLoop loop;
+    loop.init("SpawnSignals");
+
+    std::atomic<bool> exited{false};
+    std::atomic<int> status{0};
+    loop.addSignal(SIGUSR1, [](int) {});
+    RunLoopGuard guard(loop);
+
+    pid_t pid = loop.executeAndWait([&] {
+        SpawnOptions options;
+        options.argv = {"sleep", "5"};
+        options.onExit = [&](int s) {
+            status.store(s);
+            exited.store(true);
+        };
+        return spawnProcess(loop, std::move(options));
+    });
+    ASSERT_GT(pid, 0);
+
+    kill(pid, SIGUSR1);
+    for (int i = 0; i < 400 && !exited.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    ASSERT_TRUE(exited.load());
+    ASSERT_TRUE(WIFSIGNALED(status.load()));
+    EXPECT_EQ(WTERMSIG(status.load()), SIGUSR1);
+
+    loop.removeSignal(SIGUSR1);
+    loop.executeAndWait([] {});
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A child reaped behind the loop's back is reported with
+// kStatusUnknown, not as a clean exit.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(ProcessTest, ForeignReapReportsUnknownStatus)
+{
+    RunLoop loop;
+    loop.init("SpawnReaped");
+
+    std::atomic<bool> exited{false};
+    std::atomic<int> status{0};
+    SpawnOptions options;
+    options.argv = {"true"};
+    options.onExit = [&](int s) {
+        status.store(s);
+        exited.store(true);
+    };
+    // Registered before the loop runs, so nothing reaps it until then.
+    pid_t pid = spawnProcess(loop, std::move(options));
+    ASSERT_GT(pid, 0);
+    int reaped = 0;
+    ASSERT_EQ(waitpid(pid, &reaped, 0), pid);
+
+    RunLoopGuard guard(loop);
+    for (int i = 0; i < 400 && !exited.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    ASSERT_TRUE(exited.load());
+    EXPECT_EQ(status.load(), SpawnOptions::kStatusUnknown);
+}
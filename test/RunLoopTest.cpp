@@ -1,11 +1,22 @@
 #include <gtest/gtest.h>
 #include "RunLoop.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include <unistd.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <stdexcept>
 
 using namespace ms;
 using namespace std::chrono_literals;
@@ -466,6 +477,8 @@ TEST(RunLoopTest, RemoveSourceFromHandler)
 
     EXPECT_EQ(count.load(), 1);
 
+    // The removal ran on the loop thread; sync with it before closing.
+    loop.executeAndWait([] {});
     close(readFd);
     close(writeFd);
 }
@@ -507,3 +520,1437 @@ TEST(RunLoopTest, AddSourceFromAnyThread)
     close(readFd);
     close(writeFd);
 }
+
+// ═════════════════════════════════════════════════════════════════════
+// High-priority posts run before queued Normal/Low work.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, HighPriorityRunsFirst)
+{
+    RunLoop loop;
+    RunLoop::Options options;
+    options.postBudget = 10;
+    options.minLaneQuota = 2;
+    loop.init("Priority", options);
+
+    std::vector<char> order;
+    std::atomic<bool> blocked{false};
+    std::atomic<bool> release{false};
+    std::atomic<int> count{0};
+
+    RunLoopGuard guard(loop);
+
+    // Block the loop so everything below lands in the same iteration.
+    loop.executeOnRunLoop([&] {
+        blocked.store(true);
+        while (!release.load())
+            std::this_thread::sleep_for(1ms);
+    });
+    while (!blocked.load())
+        std::this_thread::sleep_for(1ms);
+
+    constexpr int N = 50;
+    for (int i = 0; i < N; ++i)
+    {
+        loop.executeOnRunLoop([&] { order.push_back('L'); count.fetch_add(1); },
+                              RunLoop::Priority::Low);
+        loop.executeOnRunLoop([&] { order.push_back('N'); count.fetch_add(1); });
+    }
+    loop.executeOnRunLoop([&] { order.push_back('H'); count.fetch_add(1); },
+                          RunLoop::Priority::High);
+    release.store(true);
+
+    for (int i = 0; i < 200 && count.load() < 2 * N + 1; ++i)
+        std::this_thread::sleep_for(5ms);
+
+    ASSERT_EQ(count.load(), 2 * N + 1);
+
+    // First batch: High, then the Normal budget, then Low's guaranteed quota.
+    EXPECT_EQ(order[0], 'H');
+    for (int i = 1; i <= 10; ++i)
+        EXPECT_EQ(order[i], 'N');
+    EXPECT_EQ(order[11], 'L');
+    EXPECT_EQ(order[12], 'L');
+
+    auto stats = loop.stats();
+    auto high = stats.lanes[static_cast<size_t>(RunLoop::Priority::High)];
+    auto normal = stats.lanes[static_cast<size_t>(RunLoop::Priority::Normal)];
+    auto low = stats.lanes[static_cast<size_t>(RunLoop::Priority::Low)];
+    EXPECT_EQ(high.posted, 1u);
+    EXPECT_EQ(high.executed, 1u);
+    EXPECT_EQ(high.deferred, 0u);
+    EXPECT_EQ(normal.posted, static_cast<uint64_t>(N + 1));
+    EXPECT_EQ(normal.executed, static_cast<uint64_t>(N + 1));
+    EXPECT_GT(normal.deferred, 0u);
+    EXPECT_EQ(low.executed, static_cast<uint64_t>(N));
+    EXPECT_GT(low.deferred, 0u);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// post() returns a future for the callable's result.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, PostReturnsFuture)
+{
+    RunLoop loop;
+    loop.init("PostFuture");
+    RunLoopGuard guard(loop);
+
+    auto future = loop.post([] { return std::this_thread::get_id(); });
+    EXPECT_NE(future.get(), std::this_thread::get_id());
+
+    auto failing = loop.post([]() -> int { throw std::runtime_error("boom"); });
+    EXPECT_THROW(failing.get(), std::runtime_error);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// executeAndWait() blocks for the result, and runs inline (instead of
+// deadlocking) when called from the loop thread.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, ExecuteAndWait)
+{
+    RunLoop loop;
+    loop.init("ExecWait");
+    RunLoopGuard guard(loop);
+
+    int value = loop.executeAndWait([] { return 7; });
+    EXPECT_EQ(value, 7);
+
+    int nested = loop.executeAndWait([&] { return loop.executeAndWait([] { return 8; }); });
+    EXPECT_EQ(nested, 8);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// executeAfter() fires once the delay has elapsed, in deadline order.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, ExecuteAfterFiresInOrder)
+{
+    RunLoop loop;
+    loop.init("Timers");
+    RunLoopGuard guard(loop);
+
+    std::vector<int> order;
+    std::atomic<int> count{0};
+    auto start = RunLoop::Clock::now();
+    RunLoop::Clock::duration elapsed{};
+
+    loop.executeAfter(30ms, [&] {
+        order.push_back(2);
+        elapsed = RunLoop::Clock::now() - start;
+        count.fetch_add(1);
+    });
+    loop.executeAfter(10ms, [&] {
+        order.push_back(1);
+        count.fetch_add(1);
+    });
+
+    for (int i = 0; i < 200 && count.load() < 2; ++i)
+        std::this_thread::sleep_for(5ms);
+
+    ASSERT_EQ(count.load(), 2);
+    EXPECT_EQ(order, (std::vector<int>{1, 2}));
+    EXPECT_GE(elapsed, 30ms);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// cancelTimer() stops a pending timer and rejects stale ids.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, CancelTimer)
+{
+    RunLoop loop;
+    loop.init("CancelTimer");
+    RunLoopGuard guard(loop);
+
+    std::atomic<bool> cancelledFired{false};
+    std::atomic<bool> fired{false};
+
+    auto id = loop.executeAfter(20ms, [&] { cancelledFired.store(true); });
+    auto other = loop.executeAfter(1ms, [&] { fired.store(true); });
+    EXPECT_NE(id, 0u);
+    EXPECT_TRUE(loop.cancelTimer(id));
+    EXPECT_FALSE(loop.cancelTimer(id));
+
+    std::this_thread::sleep_for(50ms);
+
+    EXPECT_FALSE(cancelledFired.load());
+    EXPECT_TRUE(fired.load());
+    EXPECT_FALSE(loop.cancelTimer(other));
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// waitReadable() is one-shot and can be re-armed; waitWritable() fires
+// on a writable fd.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, WaitReadableIsOneShot)
+{
+    RunLoop loop;
+    loop.init("WaitReadable");
+
+    auto [readFd, writeFd] = makePipe();
+
+    std::atomic<int> reads{0};
+    std::atomic<bool> writable{false};
+
+    RunLoopGuard guard(loop);
+
+    loop.waitReadable(readFd, [&] { reads.fetch_add(1); });
+    loop.waitWritable(writeFd, [&] { writable.store(true); });
+
+    writeByte(writeFd);
+    for (int i = 0; i < 200 && (reads.load() < 1 || !writable.load()); ++i)
+        std::this_thread::sleep_for(5ms);
+
+    EXPECT_EQ(reads.load(), 1);
+    EXPECT_TRUE(writable.load());
+
+    // Still readable (never drained), but the wait was consumed.
+    writeByte(writeFd);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(reads.load(), 1);
+
+    // Re-arming fires again straight away.
+    loop.waitReadable(readFd, [&] { reads.fetch_add(1); });
+    for (int i = 0; i < 200 && reads.load() < 2; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(reads.load(), 2);
+
+    // cancelWaits() drops a pending wait.
+    drainPipe(readFd);
+    loop.waitReadable(readFd, [&] { reads.fetch_add(1); });
+    loop.cancelWaits(readFd);
+    writeByte(writeFd);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(reads.load(), 2);
+
+    loop.cancelWaits(writeFd);
+    close(readFd);
+    close(writeFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Cancelled posts and timers are skipped; shared tokens cancel many.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, CancelledWorkIsSkipped)
+{
+    RunLoop loop;
+    loop.init("Cancel");
+
+    std::atomic<bool> blocked{false};
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    std::atomic<bool> timerFired{false};
+
+    RunLoopGuard guard(loop);
+
+    loop.executeOnRunLoop([&] {
+        blocked.store(true);
+        while (!release.load())
+            std::this_thread::sleep_for(1ms);
+    });
+    while (!blocked.load())
+        std::this_thread::sleep_for(1ms);
+
+    CancelToken shared;
+    for (int i = 0; i < 10; ++i)
+        loop.executeOnRunLoop([&] { ran.fetch_add(1); }, shared);
+    auto single = loop.executeCancellable([&] { ran.fetch_add(100); });
+    loop.executeCancellable([&] { ran.fetch_add(1000); });
+    loop.executeAfter(1ms, [&] { timerFired.store(true); }, shared);
+
+    shared.cancel();
+    single.cancel();
+    EXPECT_TRUE(shared.isCancelled());
+    release.store(true);
+
+    for (int i = 0; i < 200 && ran.load() < 1000; ++i)
+        std::this_thread::sleep_for(5ms);
+    std::this_thread::sleep_for(20ms);
+
+    EXPECT_EQ(ran.load(), 1000);
+    EXPECT_FALSE(timerFired.load());
+
+    auto normal = loop.stats().lanes[static_cast<size_t>(RunLoop::Priority::Normal)];
+    EXPECT_EQ(normal.cancelled, 11u);
+    EXPECT_EQ(normal.executed, 2u);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// executeEvery() repeats until cancelled.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, PeriodicTimer)
+{
+    RunLoop loop;
+    loop.init("Periodic");
+    RunLoopGuard guard(loop);
+
+    std::atomic<int> ticks{0};
+    auto id = loop.executeEvery(5ms, [&] { ticks.fetch_add(1); });
+
+    for (int i = 0; i < 200 && ticks.load() < 5; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_GE(ticks.load(), 5);
+
+    EXPECT_TRUE(loop.cancelTimer(id));
+    std::this_thread::sleep_for(10ms);
+    int after = ticks.load();
+    std::this_thread::sleep_for(30ms);
+    EXPECT_EQ(ticks.load(), after);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Timers with overlapping slack windows share wakeups.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, SlackCoalescesWakeups)
+{
+    RunLoop loop;
+    loop.init("Slack");
+    RunLoopGuard guard(loop);
+
+    RunLoop::TimerOptions options;
+    options.slack = 20ms;
+
+    constexpr int N = 20;
+    std::atomic<int> ticks{0};
+    std::vector<RunLoop::TimerId> ids;
+    for (int i = 0; i < N; ++i)
+    {
+        ids.push_back(loop.executeEvery(20ms + std::chrono::milliseconds(i), [&] { ticks.fetch_add(1); },
+                                        options));
+    }
+
+    for (int i = 0; i < 200 && ticks.load() < 4 * N; ++i)
+        std::this_thread::sleep_for(5ms);
+
+    for (auto id : ids)
+        loop.cancelTimer(id);
+
+    auto stats = loop.stats();
+    EXPECT_GE(stats.timersFired, static_cast<uint64_t>(4 * N));
+    // Without slack each of the N phases would wake the loop on its own.
+    EXPECT_LT(stats.timerWakeups * 4, stats.timersFired);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Missed ticks are either caught up or skipped.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, MissedTickPolicies)
+{
+    RunLoop loop;
+    loop.init("MissedTicks");
+
+    std::atomic<int> caughtUp{0};
+    std::atomic<int> skipped{0};
+    std::atomic<bool> done{false};
+
+    RunLoop::TimerOptions catchUp;
+    catchUp.missedTicks = RunLoop::MissedTicks::CatchUp;
+    auto a = loop.executeEvery(5ms, [&] { caughtUp.fetch_add(1); }, catchUp);
+    auto b = loop.executeEvery(5ms, [&] { skipped.fetch_add(1); });
+
+    // Keep the loop busy for ~6 intervals before either timer can fire.
+    loop.executeOnRunLoop([] { std::this_thread::sleep_for(32ms); });
+    loop.executeOnRunLoop([&] { done.store(true); }, RunLoop::Priority::Low);
+
+    RunLoopGuard guard(loop);
+    for (int i = 0; i < 200 && !(done.load() && skipped.load() >= 1); ++i)
+        std::this_thread::sleep_for(1ms);
+
+    loop.executeAndWait([&] {
+        loop.cancelTimer(a);
+        loop.cancelTimer(b);
+    });
+
+    EXPECT_GE(caughtUp.load(), 6);
+    EXPECT_LE(skipped.load(), caughtUp.load() - 4);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A periodic timer cancelled by another callback of the same wakeup does
+// not fire, since cancelTimer() reported it as cancelled.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, CancelTimerDueInSameWakeup)
+{
+    RunLoop loop;
+    loop.init("CancelDue");
+
+    std::atomic<int> cancelled{0};
+    std::atomic<int> victimTicks{0};
+    RunLoop::TimerId victim = 0;
+    // Both are due once the loop frees up; the earlier deadline fires first.
+    loop.executeEvery(5ms, [&] {
+        if (victim != 0)
+        {
+            cancelled.store(loop.cancelTimer(victim) ? 1 : -1);
+            victim = 0;
+        }
+    });
+    victim = loop.executeEvery(10ms, [&] { victimTicks.fetch_add(1); });
+    loop.executeOnRunLoop([] { std::this_thread::sleep_for(20ms); });
+
+    RunLoopGuard guard(loop);
+    for (int i = 0; i < 200 && cancelled.load() == 0; ++i)
+        std::this_thread::sleep_for(1ms);
+    std::this_thread::sleep_for(30ms);
+
+    EXPECT_EQ(cancelled.load(), 1);
+    EXPECT_EQ(victimTicks.load(), 0);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// High-resolution timer backends fire sub-millisecond timers without
+// rounding up to whole milliseconds.
+// ═════════════════════════════════════════════════════════════════════
+
+static RunLoop::Clock::duration medianTimerDelay(RunLoop &loop, std::chrono::microseconds delay)
+{
+    std::vector<RunLoop::Clock::duration> samples;
+    for (int i = 0; i < 21; ++i)
+    {
+        std::atomic<bool> fired{false};
+        RunLoop::Clock::time_point firedAt;
+        auto start = RunLoop::Clock::now();
+        loop.executeAfter(delay, [&] {
+            firedAt = RunLoop::Clock::now();
+            fired.store(true);
+        });
+        while (!fired.load())
+            std::this_thread::yield();
+        samples.push_back(firedAt - start);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+TEST(RunLoopTest, HighResolutionTimers)
+{
+    for (auto resolution : {RunLoop::TimerResolution::High, RunLoop::TimerResolution::TimerFd})
+    {
+        RunLoop loop;
+        RunLoop::Options options;
+        options.timerResolution = resolution;
+        loop.init("HighRes", options);
+        EXPECT_NE(loop.timerResolution(), RunLoop::TimerResolution::Millisecond);
+        EXPECT_NE(loop.timerResolution(), RunLoop::TimerResolution::High);
+
+        RunLoopGuard guard(loop);
+        auto median = medianTimerDelay(loop, 200us);
+        EXPECT_GE(median, 200us);
+        EXPECT_LT(median, 900us);
+    }
+
+    RunLoop coarse;
+    coarse.init("Coarse");
+    EXPECT_EQ(coarse.timerResolution(), RunLoop::TimerResolution::Millisecond);
+    RunLoopGuard guard(coarse);
+    EXPECT_GE(medianTimerDelay(coarse, 200us), 1ms);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Idle callables wait for a quiet iteration unless they become overdue.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, IdleCallbacks)
+{
+    RunLoop loop;
+    loop.init("Idle");
+
+    std::atomic<bool> busy{true};
+    std::atomic<bool> idleRan{false};
+    std::atomic<bool> overdueRan{false};
+
+    RunLoopGuard guard(loop);
+
+    // Keep every iteration busy by re-posting a no-op until told to stop.
+    std::function<void()> spin = [&] {
+        if (busy.load())
+            loop.executeOnRunLoop(spin);
+    };
+    loop.executeOnRunLoop(spin);
+
+    loop.executeWhenIdle([&] { idleRan.store(true); });
+    loop.executeWhenIdle([&] { overdueRan.store(true); }, 10ms);
+
+    for (int i = 0; i < 200 && !overdueRan.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_TRUE(overdueRan.load());
+    EXPECT_FALSE(idleRan.load());
+
+    busy.store(false);
+    for (int i = 0; i < 200 && !idleRan.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_TRUE(idleRan.load());
+
+    auto stats = loop.stats();
+    EXPECT_EQ(stats.idleExecuted, 2u);
+    EXPECT_EQ(stats.idleOverdue, 1u);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// dispatch() runs inline on the loop thread, up to a nesting limit.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, DispatchRunsInlineOnLoopThread)
+{
+    RunLoop loop;
+    loop.init("Dispatch");
+    EXPECT_FALSE(loop.isOnLoopThread());
+
+    RunLoopGuard guard(loop);
+
+    std::atomic<bool> onLoop{false};
+    loop.dispatch([&] { onLoop.store(loop.isOnLoopThread()); });
+    for (int i = 0; i < 200 && !onLoop.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_TRUE(onLoop.load());
+
+    // Nested dispatches run inline until the depth limit, then get posted.
+    constexpr int kChain = 100;
+    std::atomic<int> ran{0};
+    int inlineRuns = 0;
+    std::function<void(int)> step = [&](int remaining) {
+        ran.fetch_add(1);
+        if (remaining > 0)
+            loop.dispatch([&, remaining] { step(remaining - 1); });
+    };
+    loop.executeAndWait([&] {
+        step(kChain - 1);
+        inlineRuns = ran.load();
+    });
+    for (int i = 0; i < 200 && ran.load() < kChain; ++i)
+        std::this_thread::sleep_for(5ms);
+
+    EXPECT_EQ(ran.load(), kChain);
+    EXPECT_EQ(inlineRuns, static_cast<int>(RunLoop::kMaxDispatchDepth) + 1);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Microtasks run right after the current handler, ahead of queued posts.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, MicrotasksRunAfterCurrentHandler)
+{
+    RunLoop loop;
+    loop.init("Microtask");
+    RunLoopGuard guard(loop);
+
+    std::vector<std::string> order;
+    std::atomic<bool> done{false};
+
+    loop.executeOnRunLoop([&] {
+        loop.executeOnRunLoop([&] {
+            order.push_back("post");
+            done.store(true);
+        });
+        loop.executeMicrotask([&] {
+            order.push_back("micro1");
+            loop.executeMicrotask([&] { order.push_back("micro2"); });
+        });
+        order.push_back("handler");
+    });
+    loop.executeAfter(1ms, [&] {
+        loop.executeMicrotask([&] { order.push_back("timerMicro"); });
+    });
+
+    // `order` belongs to the loop thread; read it there.
+    auto snapshot = [&] { return loop.executeAndWait([&] { return order; }); };
+    auto hasTimerMicro = [](const std::vector<std::string> &seen) {
+        return std::find(seen.begin(), seen.end(), "timerMicro") != seen.end();
+    };
+    for (int i = 0; i < 200 && !(done.load() && hasTimerMicro(snapshot())); ++i)
+        std::this_thread::sleep_for(5ms);
+    std::vector<std::string> seen = snapshot();
+
+    // The timer's microtask may land anywhere relative to the posts.
+    auto timerMicro = std::find(seen.begin(), seen.end(), "timerMicro");
+    ASSERT_NE(timerMicro, seen.end());
+    seen.erase(timerMicro);
+
+    std::vector<std::string> expected{"handler", "micro1", "micro2", "post"};
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(loop.stats().microtasksExecuted, 3u);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Observers run at each iteration phase, in order, with the iteration
+// number; removed observers stop being called.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, IterationObservers)
+{
+    RunLoop loop;
+    loop.init("Observers");
+
+    std::mutex mutex;
+    std::vector<std::pair<RunLoop::Phase, uint64_t>> calls;
+    auto record = [&](RunLoop::Phase phase) {
+        return [&, phase](uint64_t iteration) {
+            std::lock_guard<std::mutex> lock(mutex);
+            calls.emplace_back(phase, iteration);
+        };
+    };
+    loop.addObserver(RunLoop::Phase::AfterHandlers, record(RunLoop::Phase::AfterHandlers));
+    auto beforeWait = loop.addObserver(RunLoop::Phase::BeforeWait, record(RunLoop::Phase::BeforeWait));
+    loop.addObserver(RunLoop::Phase::BeforePosts, record(RunLoop::Phase::BeforePosts));
+
+    RunLoopGuard guard(loop);
+    for (int i = 0; i < 5; ++i)
+        loop.executeAndWait([] {});
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_GE(calls.size(), 6u);
+        // Every complete iteration reports the three phases in order.
+        for (size_t i = 0; i + 3 <= calls.size(); i += 3)
+        {
+            EXPECT_EQ(calls[i].first, RunLoop::Phase::BeforePosts);
+            EXPECT_EQ(calls[i + 1].first, RunLoop::Phase::BeforeWait);
+            EXPECT_EQ(calls[i + 2].first, RunLoop::Phase::AfterHandlers);
+            EXPECT_EQ(calls[i].second, i / 3 + 1);
+            EXPECT_EQ(calls[i + 1].second, calls[i].second);
+            EXPECT_EQ(calls[i + 2].second, calls[i].second);
+        }
+    }
+    EXPECT_GE(loop.iteration(), 5u);
+
+    EXPECT_TRUE(loop.removeObserver(beforeWait));
+    EXPECT_FALSE(loop.removeObserver(beforeWait));
+    loop.executeAndWait([] {});
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        calls.clear();
+    }
+    for (int i = 0; i < 3; ++i)
+        loop.executeAndWait([] {});
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_FALSE(calls.empty());
+    for (const auto &call : calls)
+        EXPECT_NE(call.first, RunLoop::Phase::BeforeWait);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Removing an observer on the loop thread stops it at once, even for a
+// later phase of the iteration in progress, so its owner can go away in
+// the same callable.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, RemoveObserverOnLoopThread)
+{
+    RunLoop loop;
+    loop.init("RemoveObserver");
+
+    std::atomic<int> calls{0};
+    std::atomic<bool> removed{false};
+    std::atomic<int> lateCalls{0};
+    RunLoopGuard guard(loop);
+
+    auto id = loop.addObserver(RunLoop::Phase::BeforeWait, [&](uint64_t) {
+        calls.fetch_add(1);
+        if (removed.load())
+            lateCalls.fetch_add(1);
+    });
+    loop.executeAndWait([] {});
+    loop.executeAndWait([] {});
+    EXPECT_GT(calls.load(), 0);
+
+    // Posts run before BeforeWait in the same iteration.
+    loop.executeAndWait([&] {
+        EXPECT_TRUE(loop.removeObserver(id));
+        removed.store(true);
+    });
+    loop.executeAndWait([] {});
+    EXPECT_EQ(lateCalls.load(), 0);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// addSource() with a caller-owned handler object calls it directly, and
+// can replace a std::function source on the same fd.
+// ═════════════════════════════════════════════════════════════════════
+
+namespace
+{
+    struct CountingHandler
+    {
+        explicit CountingHandler(int readFd) : fd(readFd) {}
+
+        int fd;
+        std::atomic<int> count{0};
+        std::thread::id thread;
+
+        void operator()()
+        {
+            drainPipe(fd);
+            thread = std::this_thread::get_id();
+            count.fetch_add(1);
+        }
+    };
+
+    // For a plain function source, which has nowhere else to keep state.
+    int g_functionSourceFd = -1;
+    std::atomic<int> g_functionSourceCalls{0};
+
+    void functionSource()
+    {
+        drainPipe(g_functionSourceFd);
+        g_functionSourceCalls.fetch_add(1);
+    }
+} // namespace
+
+TEST(RunLoopTest, TypedSourceHandler)
+{
+    RunLoop loop;
+    loop.init("TypedSource");
+
+    auto [readFd, writeFd] = makePipe();
+
+    std::atomic<int> erased{0};
+    loop.addSource(readFd, [&] {
+        drainPipe(readFd);
+        erased.fetch_add(1);
+    });
+
+    CountingHandler handler{readFd};
+    loop.addSource(readFd, &handler);
+
+    std::thread::id loopThreadId;
+    loop.executeOnRunLoop([&] { loopThreadId = std::this_thread::get_id(); });
+
+    RunLoopGuard guard(loop);
+
+    for (int n = 1; n <= 3; ++n)
+    {
+        writeByte(writeFd);
+        for (int i = 0; i < 200 && handler.count.load() < n; ++i)
+            std::this_thread::sleep_for(5ms);
+    }
+
+    EXPECT_EQ(handler.count.load(), 3);
+    EXPECT_EQ(erased.load(), 0);
+    EXPECT_EQ(handler.thread, loopThreadId);
+
+    loop.removeSource(readFd);
+    writeByte(writeFd);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(handler.count.load(), 3);
+
+    // A function (pointer) is not a handler object: it converts to
+    // std::function and takes the ordinary overload.
+    g_functionSourceFd = readFd;
+    loop.addSource(readFd, functionSource);
+    for (int i = 0; i < 200 && g_functionSourceCalls.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(g_functionSourceCalls.load(), 1);
+    EXPECT_EQ(handler.count.load(), 3);
+
+    loop.removeSource(readFd);
+    loop.executeAndWait([] {});
+    close(readFd);
+    close(writeFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// LocalRunLoop: the single-threaded variant, driven entirely from the
+// thread that calls run().
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, LocalRunLoopSingleThreaded)
+{
+    LocalRunLoop loop;
+    loop.init("Local");
+    EXPECT_TRUE(loop.isOnLoopThread());
+
+    auto [readFd, writeFd] = makePipe();
+
+    std::vector<std::string> order;
+    int sourceHits = 0;
+    loop.addSource(readFd, [&] {
+        drainPipe(readFd);
+        ++sourceHits;
+        order.push_back("source");
+        loop.stop();
+    });
+
+    loop.executeOnRunLoop([&] { order.push_back("low"); }, RunLoop::Priority::Low);
+    loop.executeOnRunLoop([&] {
+        order.push_back("high");
+        loop.executeMicrotask([&] { order.push_back("micro"); });
+    }, RunLoop::Priority::High);
+    loop.dispatch([&] { order.push_back("inline"); });
+
+    loop.executeAfter(1ms, [&] {
+        order.push_back("timer");
+        int answer = loop.executeAndWait([] { return 42; });
+        EXPECT_EQ(answer, 42);
+        writeByte(writeFd);
+    });
+
+    loop.run();
+
+    std::vector<std::string> expected{"inline", "high", "micro", "low", "timer", "source"};
+    EXPECT_EQ(order, expected);
+    EXPECT_EQ(sourceHits, 1);
+    EXPECT_FALSE(loop.isRunning());
+
+    auto stats = loop.stats();
+    EXPECT_EQ(stats.timersFired, 1u);
+    EXPECT_EQ(stats.microtasksExecuted, 1u);
+
+    close(readFd);
+    close(writeFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// The epoll batch grows while waits come back full and shrinks again
+// after a run of sparse waits.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, AdaptiveEventBatch)
+{
+    RunLoop loop;
+    RunLoop::Options options;
+    options.eventBatch = 4;
+    options.maxEventBatch = 64;
+    loop.init("Batch", options);
+
+    // 128 sources that stay readable until told to drain.
+    constexpr int kSources = 128;
+    std::vector<std::pair<int, int>> pipes;
+    std::atomic<bool> drain{false};
+    std::atomic<int> hits{0};
+    for (int i = 0; i < kSources; ++i)
+    {
+        auto pipe = makePipe();
+        pipes.push_back(pipe);
+        writeByte(pipe.second);
+        loop.addSource(pipe.first, [&, fd = pipe.first] {
+            if (drain.load())
+                drainPipe(fd);
+            hits.fetch_add(1);
+        });
+    }
+
+    RunLoopGuard guard(loop);
+    for (int i = 0; i < 200 && loop.stats().eventBatch < 64; ++i)
+        std::this_thread::sleep_for(5ms);
+
+    auto grown = loop.stats();
+    EXPECT_EQ(grown.eventBatch, 64u);
+    EXPECT_GT(grown.fullBatches, 0u);
+    EXPECT_GT(grown.eventsReceived, grown.eventWaits);
+
+    // One ready fd per wait from now on.
+    drain.store(true);
+    std::this_thread::sleep_for(20ms);
+    for (int i = 0; i < 300 && loop.stats().eventBatch > 4; ++i)
+    {
+        int before = hits.load();
+        writeByte(pipes[0].second);
+        for (int j = 0; j < 200 && hits.load() == before; ++j)
+            std::this_thread::sleep_for(100us);
+    }
+    EXPECT_EQ(loop.stats().eventBatch, 4u);
+
+    for (auto [readFd, writeFd] : pipes)
+    {
+        loop.removeSource(readFd);
+        close(readFd);
+        close(writeFd);
+    }
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// parkOnFutex: a loop without fds parks on a futex, still runs posts and
+// timers, and switches to epoll once a source is added.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, FutexParking)
+{
+    RunLoop loop;
+    RunLoop::Options options;
+    options.parkOnFutex = true;
+    loop.init("Futex", options);
+
+    RunLoopGuard guard(loop);
+    std::this_thread::sleep_for(10ms);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        EXPECT_EQ(loop.executeAndWait([i] { return i; }), i);
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_GT(loop.stats().futexParks, 0u);
+
+    std::atomic<bool> timerFired{false};
+    loop.executeAfter(5ms, [&] { timerFired.store(true); });
+    for (int i = 0; i < 200 && !timerFired.load(); ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_TRUE(timerFired.load());
+
+    // The loop is parked; adding a source must move it onto epoll.
+    auto [readFd, writeFd] = makePipe();
+    std::atomic<int> count{0};
+    std::this_thread::sleep_for(10ms);
+    loop.addSource(readFd, [&] {
+        drainPipe(readFd);
+        count.fetch_add(1);
+    });
+    std::this_thread::sleep_for(10ms);
+    writeByte(writeFd);
+    for (int i = 0; i < 200 && count.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(count.load(), 1);
+
+    // Back to a pure queue: parking resumes.
+    loop.removeSource(readFd);
+    loop.executeAndWait([] {});
+    uint64_t parks = loop.stats().futexParks;
+    std::this_thread::sleep_for(10ms);
+    EXPECT_EQ(loop.executeAndWait([] { return 7; }), 7);
+    for (int i = 0; i < 200 && loop.stats().futexParks <= parks; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_GT(loop.stats().futexParks, parks);
+
+    close(readFd);
+    close(writeFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Cross-thread source changes go through a command queue: a bulk add
+// registers every fd, an add/remove pair cancels out, and a queued
+// removal wins over an event that is already pending.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, SourceCommandQueue)
+{
+    RunLoop loop;
+    loop.init("SourceCommands");
+
+    RunLoopGuard guard(loop);
+    std::this_thread::sleep_for(10ms);
+
+    constexpr int kPipes = 8;
+    std::vector<std::pair<int, int>> pipes;
+    std::atomic<int> fired{0};
+    std::vector<std::pair<int, std::function<void()>>> sources;
+    for (int i = 0; i < kPipes; ++i)
+    {
+        auto p = makePipe();
+        pipes.push_back(p);
+        int readFd = p.first;
+        sources.emplace_back(readFd, [&fired, readFd] {
+            drainPipe(readFd);
+            fired.fetch_add(1);
+        });
+    }
+    loop.addSources(std::move(sources));
+    for (auto &p : pipes)
+        writeByte(p.second);
+    for (int i = 0; i < 200 && fired.load() < kPipes; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(fired.load(), kPipes);
+
+    // Add and remove before the loop gets to them: nothing is registered.
+    // removeSource() waits for the loop, so the removals are queued from
+    // helper threads while it is held.
+    auto [readFd, writeFd] = makePipe();
+    std::atomic<bool> stale{false};
+    std::atomic<bool> release{false};
+    loop.executeOnRunLoop([&] {
+        while (!release.load())
+            std::this_thread::sleep_for(1ms);
+    });
+    loop.addSource(readFd, [&] { stale.store(true); });
+    std::thread removeAdded([&, fd = readFd] { loop.removeSource(fd); });
+
+    // Removal queued while an event for the fd is already pending.
+    writeByte(pipes[0].second);
+    std::thread removePending([&] { loop.removeSource(pipes[0].first); });
+    std::this_thread::sleep_for(10ms);
+    release.store(true);
+    removeAdded.join();
+    removePending.join();
+
+    writeByte(writeFd);
+    loop.executeAndWait([] {});
+    std::this_thread::sleep_for(20ms);
+    EXPECT_FALSE(stale.load());
+    EXPECT_EQ(fired.load(), kPipes);
+
+    for (int i = 1; i < kPipes; ++i)
+        loop.removeSource(pipes[i].first);
+    loop.executeAndWait([] {});
+    for (auto &p : pipes)
+    {
+        close(p.first);
+        close(p.second);
+    }
+    close(readFd);
+    close(writeFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A removed fd may be closed as soon as removeSource() returns. When its
+// number is reused and registered on the loop thread, the old removal
+// must not undo the new source.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, RemovedFdNumberReused)
+{
+    RunLoop loop;
+    loop.init("FdReuse");
+
+    auto [oldRead, oldWrite] = makePipe();
+    std::atomic<int> stale{0};
+    std::atomic<int> fired{0};
+    loop.addSource(oldRead, [&] { stale.fetch_add(1); });
+    {
+        RunLoopGuard guard(loop);
+        loop.executeAndWait([] {});
+    }
+
+    // Stopped loop: the removal is still queued when the fd is closed and
+    // a posted callable registers a new pipe under the same number.
+    loop.removeSource(oldRead);
+    close(oldRead);
+    close(oldWrite);
+    int newRead = -1;
+    int newWrite = -1;
+    loop.executeOnRunLoop([&] {
+        std::tie(newRead, newWrite) = makePipe();
+        loop.addSource(newRead, [&] {
+            drainPipe(newRead);
+            fired.fetch_add(1);
+        });
+        writeByte(newWrite);
+    });
+
+    RunLoopGuard guard(loop);
+    for (int i = 0; i < 200 && fired.load() == 0; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(loop.executeAndWait([&] { return newRead; }), oldRead);
+    EXPECT_EQ(fired.load(), 1);
+    EXPECT_EQ(stale.load(), 0);
+
+    // Running loop: removal has been applied by the time it returns.
+    loop.removeSource(newRead);
+    writeByte(newWrite);
+    loop.executeAndWait([] {});
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(fired.load(), 1);
+    close(newRead);
+    close(newWrite);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// pauseSource/resumeSource: a paused source keeps its registration but is
+// not dispatched; data that arrived meanwhile is reported on resume.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, PauseAndResumeSource)
+{
+    RunLoop loop;
+    loop.init("PauseSource");
+
+    auto [readFd, writeFd] = makePipe();
+    std::atomic<int> count{0};
+    loop.addSource(readFd, [&] {
+        drainPipe(readFd);
+        count.fetch_add(1);
+    });
+
+    RunLoopGuard guard(loop);
+    std::this_thread::sleep_for(10ms);
+
+    // A pause that ends before the fd is ready changes nothing.
+    loop.executeAndWait([&] {
+        loop.pauseSource(readFd);
+        loop.resumeSource(readFd);
+    });
+    writeByte(writeFd);
+    for (int i = 0; i < 200 && count.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(count.load(), 1);
+
+    // Paused from another thread: the byte waits until resume.
+    loop.pauseSource(readFd);
+    loop.executeAndWait([] {});
+    writeByte(writeFd);
+    std::this_thread::sleep_for(30ms);
+    EXPECT_EQ(count.load(), 1);
+
+    loop.resumeSource(readFd);
+    for (int i = 0; i < 200 && count.load() < 2; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(count.load(), 2);
+
+    // Pause from the handler itself, as flow control would.
+    std::atomic<int> paused{0};
+    loop.executeAndWait([&] {
+        loop.addSource(readFd, [&] {
+            drainPipe(readFd);
+            paused.fetch_add(1);
+            loop.pauseSource(readFd);
+        });
+    });
+    writeByte(writeFd);
+    for (int i = 0; i < 200 && paused.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    writeByte(writeFd);
+    std::this_thread::sleep_for(30ms);
+    EXPECT_EQ(paused.load(), 1);
+
+    loop.executeAndWait([&] { loop.resumeSource(readFd); });
+    for (int i = 0; i < 200 && paused.load() < 2; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(paused.load(), 2);
+
+    // Paused again by the handler. Once its peer hangs up the fd must not
+    // spin the loop: epoll reports EPOLLHUP even with no interest set.
+    writeByte(writeFd);
+    std::this_thread::sleep_for(30ms);
+    close(writeFd);
+    std::this_thread::sleep_for(10ms);
+    uint64_t before = loop.iteration();
+    std::this_thread::sleep_for(50ms);
+    EXPECT_LT(loop.iteration() - before, 10u);
+    EXPECT_EQ(paused.load(), 2);
+
+    loop.removeSource(readFd);
+    loop.executeAndWait([] {});
+    close(readFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Read-mode sources: the loop reads into a pooled buffer, so many fds
+// share one buffer; EOF is reported as 0.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, ReadSourceUsesPooledBuffers)
+{
+    RunLoop loop;
+    loop.init("ReadSource");
+
+    constexpr int kPipes = 16;
+    std::vector<std::pair<int, int>> pipes;
+    std::mutex mutex;
+    std::string received;
+    std::atomic<int> eofs{0};
+    for (int i = 0; i < kPipes; ++i)
+    {
+        auto p = makePipe();
+        pipes.push_back(p);
+        loop.addReadSource(p.first, [&, fd = p.first](const char *data, ssize_t n) {
+            ASSERT_GE(n, 0);
+            if (n == 0)
+            {
+                loop.removeSource(fd);
+                eofs.fetch_add(1);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            received.append(data, static_cast<size_t>(n));
+        });
+    }
+
+    RunLoopGuard guard(loop);
+    std::this_thread::sleep_for(10ms);
+
+    for (auto &p : pipes)
+    {
+        ASSERT_EQ(write(p.second, "ab", 2), 2);
+        close(p.second);
+    }
+    for (int i = 0; i < 200 && eofs.load() < kPipes; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(eofs.load(), kPipes);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(received.size(), 2u * kPipes);
+    }
+    auto stats = loop.stats();
+    EXPECT_GE(stats.pooledReads, 2u * kPipes);
+    EXPECT_EQ(stats.readBuffers, 1u);
+
+    for (auto &p : pipes)
+        close(p.first);
+
+    // A zero buffer size is raised to one byte; reading nothing would look
+    // like end of file.
+    RunLoop::Options options;
+    options.readBufferSize = 0;
+    RunLoop tiny;
+    tiny.init("ReadSourceTiny", options);
+    auto [readFd, writeFd] = makePipe();
+    std::atomic<int> bytes{0};
+    std::atomic<bool> eof{false};
+    tiny.addReadSource(readFd, [&](const char *, ssize_t n) {
+        if (n > 0)
+            bytes.fetch_add(static_cast<int>(n));
+        else
+            eof.store(true);
+    });
+    RunLoopGuard tinyGuard(tiny);
+    ASSERT_EQ(write(writeFd, "ab", 2), 2);
+    for (int i = 0; i < 200 && bytes.load() < 2; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(bytes.load(), 2);
+    EXPECT_FALSE(eof.load());
+    tiny.removeSource(readFd);
+    close(readFd);
+    close(writeFd);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// addSignal: signals arrive as loop callbacks, repeats are coalesced, and
+// a signal delivered while unhandled stays pending until re-added.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, SignalHandlers)
+{
+    RunLoop loop;
+    loop.init("Signals");
+
+    std::atomic<int> usr1{0};
+    std::atomic<int> usr2{0};
+    std::thread::id handlerThread;
+    // Blocks the signals in this thread before the loop thread inherits
+    // the mask.
+    loop.addSignal(SIGUSR1, [&](int signo) {
+        EXPECT_EQ(signo, SIGUSR1);
+        handlerThread = std::this_thread::get_id();
+        usr1.fetch_add(1);
+    });
+    loop.addSignal(SIGUSR2, [&](int) { usr2.fetch_add(1); });
+
+    RunLoopGuard guard(loop);
+    std::this_thread::sleep_for(10ms);
+
+    kill(getpid(), SIGUSR1);
+    for (int i = 0; i < 200 && usr1.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(usr1.load(), 1);
+    EXPECT_EQ(handlerThread, guard.thread.get_id());
+
+    // Several deliveries while the loop is busy: one call per signal.
+    std::atomic<bool> release{false};
+    loop.executeOnRunLoop([&] {
+        while (!release.load())
+            std::this_thread::sleep_for(1ms);
+    });
+    for (int i = 0; i < 3; ++i)
+    {
+        kill(getpid(), SIGUSR1);
+        kill(getpid(), SIGUSR2);
+    }
+    release.store(true);
+    for (int i = 0; i < 200 && (usr1.load() < 2 || usr2.load() < 1); ++i)
+        std::this_thread::sleep_for(5ms);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(usr1.load(), 2);
+    EXPECT_EQ(usr2.load(), 1);
+
+    // Unhandled but still blocked: the delivery waits for a new handler.
+    loop.removeSignal(SIGUSR2);
+    loop.executeAndWait([] {});
+    kill(getpid(), SIGUSR2);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(usr2.load(), 1);
+
+    loop.addSignal(SIGUSR2, [&](int) { usr2.fetch_add(10); });
+    for (int i = 0; i < 200 && usr2.load() < 11; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(usr2.load(), 11);
+
+    loop.removeSignal(SIGUSR1);
+    loop.removeSignal(SIGUSR2);
+    loop.executeAndWait([] {});
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// With parkOnFutex, a loop whose only fd is its signalfd must stay on
+// epoll: parked on the futex it would never read a signal.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, SignalsWithFutexParking)
+{
+    RunLoop loop;
+    RunLoop::Options options;
+    options.parkOnFutex = true;
+    loop.init("SignalPark", options);
+
+    std::atomic<int> received{0};
+    loop.addSignal(SIGUSR1, [&](int) { received.fetch_add(1); });
+
+    RunLoopGuard guard(loop);
+    loop.executeAndWait([] {});
+    std::this_thread::sleep_for(10ms);
+
+    kill(getpid(), SIGUSR1);
+    for (int i = 0; i < 200 && received.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(received.load(), 1);
+
+    loop.removeSignal(SIGUSR1);
+    loop.executeAndWait([] {});
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// addWatch: inotify events reach the handler on the loop thread, a burst
+// of writes to one file is merged into one call, and directory watches
+// name the entry.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, FileWatches)
+{
+    char dir[] = "/tmp/runloop-watch-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string file = std::string(dir) + "/log";
+    int fd = open(file.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0600);
+    ASSERT_GE(fd, 0);
+
+    std::atomic<int> fileCalls{0};
+    std::atomic<uint32_t> fileEvents{0};
+    std::mutex mutex;
+    std::vector<std::string> created;
+
+    RunLoop loop;
+    loop.init("Watches");
+    RunLoopGuard guard(loop);
+
+    RunLoop::WatchId fileWatch = loop.addWatch(file, IN_MODIFY, [&](uint32_t events, const std::string &name) {
+        EXPECT_TRUE(name.empty());
+        fileEvents.fetch_or(events);
+        fileCalls.fetch_add(1);
+    });
+    ASSERT_GE(fileWatch, 0);
+
+    ASSERT_GE(loop.addWatch(dir, IN_CREATE,
+                            [&](uint32_t, const std::string &name) {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                created.push_back(name);
+                            }),
+              0);
+    loop.executeAndWait([] {});
+
+    // Ten writes while the loop is busy: one merged call.
+    std::atomic<bool> release{false};
+    loop.executeOnRunLoop([&] {
+        while (!release.load())
+            std::this_thread::sleep_for(1ms);
+    });
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(write(fd, "x", 1), 1);
+    }
+    release.store(true);
+    for (int i = 0; i < 200 && fileCalls.load() < 1; ++i)
+        std::this_thread::sleep_for(5ms);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(fileCalls.load(), 1);
+    EXPECT_TRUE(fileEvents.load() & IN_MODIFY);
+
+    std::string other = std::string(dir) + "/config";
+    int otherFd = open(other.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0600);
+    ASSERT_GE(otherFd, 0);
+    close(otherFd);
+    for (int i = 0; i < 200; ++i)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!created.empty())
+                break;
+        }
+        std::this_thread::sleep_for(5ms);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_EQ(created.size(), 1u);
+        EXPECT_EQ(created[0], "config");
+    }
+
+    // After removal nothing more is reported.
+    loop.removeWatch(fileWatch);
+    loop.executeAndWait([] {});
+    ASSERT_EQ(write(fd, "y", 1), 1);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(fileCalls.load(), 1);
+
+    close(fd);
+    unlink(file.c_str());
+    unlink(other.c_str());
+    rmdir(dir);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// addSharedSource: an fd watched by several loops wakes one of them per
+// event instead of all of them. Wakeups are counted as the loop threads'
+// voluntary context switches, since a herd wakeup that finds nothing
+// ready never reaches a handler.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(RunLoopTest, SharedSourceWakesOneLoop)
+{
+    constexpr int kLoops = 4;
+    constexpr int kEvents = 50;
+
+    int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ASSERT_GE(efd, 0);
+
+    std::atomic<int> handled{0};
+    std::vector<std::unique_ptr<RunLoop>> loops;
+    std::vector<std::unique_ptr<RunLoopGuard>> guards;
+    for (int i = 0; i < kLoops; ++i)
+    {
+        loops.push_back(std::make_unique<RunLoop>());
+        loops.back()->init("Shared");
+        loops.back()->addSharedSource(efd, [&] {
+            uint64_t value;
+            if (read(efd, &value, sizeof(value)) == sizeof(value))
+                handled.fetch_add(1);
+        });
+        guards.push_back(std::make_unique<RunLoopGuard>(*loops.back()));
+    }
+    std::this_thread::sleep_for(20ms);
+
+    auto loopSwitches = [&] {
+        long total = 0;
+        for (auto &loop : loops)
+        {
+            total += loop->executeAndWait([] {
+                rusage usage{};
+                getrusage(RUSAGE_THREAD, &usage);
+                return usage.ru_nvcsw;
+            });
+        }
+        return total;
+    };
+    long before = loopSwitches();
+
+    for (int i = 0; i < kEvents; ++i)
+    {
+        uint64_t one = 1;
+        ASSERT_EQ(write(efd, &one, sizeof(one)), static_cast<ssize_t>(sizeof(one)));
+        for (int j = 0; j < 200 && handled.load() <= i; ++j)
+            std::this_thread::sleep_for(1ms);
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(handled.load(), kEvents);
+
+    // A herd would wake all four loops per event; the reads of the
+    // switch counters add one wakeup per loop.
+    long wakeups = loopSwitches() - before - kLoops;
+    EXPECT_LT(wakeups, kEvents * 2);
+
+    guards.clear();
+    close(efd);
+}
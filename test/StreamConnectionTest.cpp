@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "StreamConnection.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace ms;
+using namespace std::chrono_literals;
+
+namespace
+{
+    struct RunLoopGuard
+    {
+        RunLoop &loop;
+        std::thread thread;
+
+        explicit RunLoopGuard(RunLoop &l) : loop(l), thread([&l] { l.run(); }) {}
+
+        ~RunLoopGuard()
+        {
+            loop.stop();
+            if (thread.joinable())
+                thread.join();
+        }
+    };
+
+    // Reads from blocking `fd` until `size` bytes or end of file.
+    std::string readExactly(int fd, size_t size)
+    {
+        std::string data;
+        char buf[4096];
+        while (data.size() < size)
+        {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                break;
+            data.append(buf, static_cast<size_t>(n));
+        }
+        return data;
+    }
+} // namespace
+
+// ═════════════════════════════════════════════════════════════════════
+// Sends queued during one turn leave in a single write; input the
+// handler does not consume yet is kept for the next read.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(StreamConnectionTest, SmallSendsCoalesceIntoOneWrite)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+
+    RunLoop loop;
+    loop.init("StreamCoalesce");
+    std::string lines;
+    std::atomic<int> closed{1};
+    StreamConnection conn;
+    RunLoopGuard guard(loop);
+
+    // Consume whole lines only.
+    loop.executeAndWait([&] {
+        bool opened = conn.open(
+            loop, fds[0],
+            [&](const char *data, size_t size) {
+                std::string text(data, size);
+                size_t end = text.rfind('\n');
+                if (end == std::string::npos)
+                    return size_t{0};
+                lines += text.substr(0, end + 1);
+                return end + 1;
+            },
+            [&](int error) { closed.store(error); });
+        EXPECT_TRUE(opened);
+    });
+
+    loop.executeAndWait([&] {
+        for (int i = 0; i < 100; ++i)
+        {
+            conn.send("message " + std::to_string(i) + "\n");
+        }
+        EXPECT_EQ(conn.stats().writes, 0u);
+        EXPECT_GT(conn.pendingOutput(), 0u);
+    });
+
+    std::string expected;
+    for (int i = 0; i < 100; ++i)
+        expected += "message " + std::to_string(i) + "\n";
+    EXPECT_EQ(readExactly(fds[1], expected.size()), expected);
+
+    auto stats = loop.executeAndWait([&] { return conn.stats(); });
+    EXPECT_EQ(stats.sends, 100u);
+    EXPECT_EQ(stats.writes, 1u);
+    EXPECT_EQ(stats.bytesWritten, expected.size());
+    EXPECT_EQ(stats.stalls, 0u);
+
+    // A line split across two reads arrives whole.
+    ASSERT_EQ(write(fds[1], "hel", 3), 3);
+    for (int i = 0; i < 200 && loop.executeAndWait([&] { return conn.stats().bytesRead; }) < 3; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_TRUE(loop.executeAndWait([&] { return lines; }).empty());
+    ASSERT_EQ(write(fds[1], "lo\nwor", 6), 6);
+    for (int i = 0; i < 200 && loop.executeAndWait([&] { return lines; }).empty(); ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(loop.executeAndWait([&] { return lines; }), "hello\n");
+
+    // Peer closes: end of file reported once, fd released.
+    close(fds[1]);
+    for (int i = 0; i < 200 && closed.load() != 0; ++i)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(closed.load(), 0);
+    EXPECT_FALSE(loop.executeAndWait([&] { return conn.isOpen(); }));
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// More output than the socket takes: the rest waits for EPOLLOUT and
+// drains as the peer reads, without further send() calls.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(StreamConnectionTest, PartialWriteWaitsForWritable)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+    int small = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+
+    RunLoop loop;
+    loop.init("StreamPartial");
+    StreamConnection conn;
+    RunLoopGuard guard(loop);
+
+    std::string payload(1 << 20, '\0');
+    for (size_t i = 0; i < payload.size(); ++i)
+        payload[i] = static_cast<char>('a' + i % 26);
+
+    StreamConnection::Options options;
+    options.flushThreshold = 64 * 1024;
+    loop.executeAndWait([&] {
+        EXPECT_TRUE(conn.open(
+            loop, fds[0], [](const char *, size_t size) { return size; }, [](int) {}, options));
+        conn.send(payload);
+        EXPECT_GT(conn.pendingOutput(), 0u);
+        EXPECT_GE(conn.stats().stalls, 1u);
+    });
+
+    EXPECT_EQ(readExactly(fds[1], payload.size()), payload);
+
+    for (int i = 0; i < 200 && loop.executeAndWait([&] { return conn.pendingOutput(); }) > 0; ++i)
+        std::this_thread::sleep_for(5ms);
+    auto stats = loop.executeAndWait([&] { return conn.stats(); });
+    EXPECT_EQ(stats.sends, 1u);
+    EXPECT_EQ(stats.bytesWritten, payload.size());
+    EXPECT_GT(stats.writes, 1u);
+
+    loop.executeAndWait([&] { conn.close(); });
+    close(fds[1]);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Pipes are refused and stay with the caller. A peer that went away is
+// reported as -EPIPE through the close handler, not as SIGPIPE.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(StreamConnectionTest, RejectsPipesAndReportsEpipe)
+{
+    RunLoop loop;
+    loop.init("StreamEpipe");
+    std::atomic<int> closed{1};
+    StreamConnection conn;
+    RunLoopGuard guard(loop);
+
+    int pipeFds[2];
+    ASSERT_EQ(pipe(pipeFds), 0);
+    loop.executeAndWait([&] {
+        EXPECT_FALSE(conn.open(
+            loop, pipeFds[1], [](const char *, size_t size) { return size; }, [](int) {}));
+        EXPECT_EQ(errno, ENOTSOCK);
+        EXPECT_FALSE(conn.isOpen());
+    });
+    EXPECT_EQ(close(pipeFds[0]), 0);
+    EXPECT_EQ(close(pipeFds[1]), 0);
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+    loop.executeAndWait([&] {
+        ASSERT_TRUE(conn.open(
+            loop, fds[0], [](const char *, size_t size) { return size; }, [&](int error) { closed.store(error); }));
+        // The peer goes away before the loop hears of it.
+        close(fds[1]);
+        conn.send("late reply\n");
+        conn.flush();
+    });
+    EXPECT_EQ(closed.load(), -EPIPE);
+    EXPECT_FALSE(loop.executeAndWait([&] { return conn.isOpen(); }));
+}
@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+#include "Task.h"
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace ms;
+using namespace std::chrono_literals;
+
+// Helper: run loop in background, auto-stop on scope exit.
+struct RunLoopGuard
+{
+    RunLoop &loop;
+    std::thread thread;
+
+    explicit RunLoopGuard(RunLoop &l) : loop(l), thread([&l] { l.run(); }) {}
+
+    ~RunLoopGuard()
+    {
+        loop.stop();
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+static Task<std::thread::id> loopThreadId(RunLoop &loop)
+{
+    co_await schedule(loop);
+    co_return std::this_thread::get_id();
+}
+
+static Task<int> add(RunLoop &loop, int a, int b)
+{
+    co_await schedule(loop);
+    co_return a + b;
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// co_await schedule(loop) resumes on the loop thread.
+// ═════════════════════════════════════════════════════════════════════
+
+TEST(TaskTest, ScheduleHopsToLoop)
+{
+    RunLoop loop;
+    loop.init("Schedule");
+
+    std::thread::id expected;
+    loop.executeOnRunLoop([&] { expected = std::this_thread::get_id(); });
+    RunLoopGuard guard(loop);
+
+    auto id = spawn(loop, loopThreadId(loop)).get();
+    EXPECT_EQ(id, expected);
+    EXPECT_NE(id, std::this_thread::get_id());
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Tasks compose: awaiting a Task returns its value.
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<int> sumOfThree(RunLoop &loop)
+{
+    int ab = co_await add(loop, 1, 2);
+    int abc = co_await add(loop, ab, 3);
+    co_return abc;
+}
+
+TEST(TaskTest, NestedTasks)
+{
+    RunLoop loop;
+    loop.init("Nested");
+    RunLoopGuard guard(loop);
+
+    EXPECT_EQ(spawn(loop, sumOfThree(loop)).get(), 6);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// co_await sleepFor(loop, d) resumes after the delay.
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<RunLoop::Clock::duration> timedSleep(RunLoop &loop)
+{
+    auto start = RunLoop::Clock::now();
+    co_await sleepFor(loop, 20ms);
+    co_await sleepFor(loop, 0ms);
+    co_return RunLoop::Clock::now() - start;
+}
+
+TEST(TaskTest, SleepFor)
+{
+    RunLoop loop;
+    loop.init("Sleep");
+    RunLoopGuard guard(loop);
+
+    EXPECT_GE(spawn(loop, timedSleep(loop)).get(), 20ms);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Exceptions propagate through co_await and spawn().
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<void> failing(RunLoop &loop)
+{
+    co_await schedule(loop);
+    throw std::runtime_error("boom");
+}
+
+static Task<bool> catches(RunLoop &loop)
+{
+    try
+    {
+        co_await failing(loop);
+    }
+    catch (const std::runtime_error &)
+    {
+        co_return true;
+    }
+    co_return false;
+}
+
+TEST(TaskTest, ExceptionsPropagate)
+{
+    RunLoop loop;
+    loop.init("Errors");
+    RunLoopGuard guard(loop);
+
+    EXPECT_TRUE(spawn(loop, catches(loop)).get());
+    EXPECT_THROW(spawn(loop, failing(loop)).get(), std::runtime_error);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// A long chain of awaits completes without recursion or leaks.
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<int> one()
+{
+    co_return 1;
+}
+
+static Task<int> manyAwaits(RunLoop &loop)
+{
+    int total = 0;
+    for (int i = 0; i < 10000; ++i)
+    {
+        total += co_await one();
+    }
+    co_await schedule(loop);
+    co_return total;
+}
+
+TEST(TaskTest, ManySynchronousAwaits)
+{
+    RunLoop loop;
+    loop.init("Chain");
+    RunLoopGuard guard(loop);
+
+    EXPECT_EQ(spawn(loop, manyAwaits(loop)).get(), 10000);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// asyncRead() completes without suspending when data is already there,
+// and waits for readiness when it is not.
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<std::string> readTwice(RunLoop &loop, int fd)
+{
+    co_await schedule(loop);
+
+    char buf[16];
+    ssize_t n = co_await asyncRead(loop, fd, buf, sizeof(buf));
+    std::string out(buf, n > 0 ? static_cast<size_t>(n) : 0);
+
+    // Nothing buffered now: this one has to wait for the writer.
+    n = co_await asyncRead(loop, fd, buf, sizeof(buf));
+    out.append(buf, n > 0 ? static_cast<size_t>(n) : 0);
+    co_return out;
+}
+
+TEST(TaskTest, AsyncRead)
+{
+    RunLoop loop;
+    loop.init("AsyncRead");
+    RunLoopGuard guard(loop);
+
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_CLOEXEC | O_NONBLOCK), 0);
+    ASSERT_EQ(write(fds[1], "ab", 2), 2);
+
+    auto result = spawn(loop, readTwice(loop, fds[0]));
+    std::this_thread::sleep_for(20ms);
+    EXPECT_FALSE(result.isReady());
+
+    ASSERT_EQ(write(fds[1], "cd", 2), 2);
+    EXPECT_EQ(result.get(), "abcd");
+
+    loop.cancelWaits(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// asyncWrite() waits for space in a full pipe; readable() resumes once
+// data arrives; errors come back as -errno.
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<ssize_t> fillThenWrite(RunLoop &loop, int fd)
+{
+    co_await schedule(loop);
+
+    char chunk[4096] = {};
+    while (write(fd, chunk, sizeof(chunk)) > 0) {}
+
+    co_await writable(loop, fd);
+    co_return co_await asyncWrite(loop, fd, "x", 1);
+}
+
+static Task<void> waitReadable(RunLoop &loop, int fd)
+{
+    co_await schedule(loop);
+    co_await readable(loop, fd);
+}
+
+TEST(TaskTest, AsyncWriteAndReadiness)
+{
+    RunLoop loop;
+    loop.init("AsyncWrite");
+    RunLoopGuard guard(loop);
+
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_CLOEXEC | O_NONBLOCK), 0);
+
+    auto readable = spawn(loop, waitReadable(loop, fds[0]));
+    auto written = spawn(loop, fillThenWrite(loop, fds[1]));
+
+    // The pipe is now full and has data.
+    readable.get();
+    std::this_thread::sleep_for(20ms);
+    EXPECT_FALSE(written.isReady());
+
+    char buf[4096];
+    while (read(fds[0], buf, sizeof(buf)) > 0) {}
+    EXPECT_EQ(written.get(), 1);
+
+    char byte;
+    EXPECT_EQ(spawn(loop, [](RunLoop &l, char *b) -> Task<ssize_t> {
+                  co_return co_await asyncRead(l, -1, b, 1);
+              }(loop, &byte)).get(),
+              -EBADF);
+
+    loop.cancelWaits(fds[0]);
+    loop.cancelWaits(fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// ═════════════════════════════════════════════════════════════════════
+// Coroutines also run on a single-threaded LocalRunLoop.
+// ═════════════════════════════════════════════════════════════════════
+
+static Task<int> localSleep(LocalRunLoop &loop)
+{
+    co_await schedule(loop);
+    co_await sleepFor(loop, 1ms);
+    co_return 7;
+}
+
+static Task<void> localMain(LocalRunLoop &loop, int &out)
+{
+    out = co_await localSleep(loop);
+    loop.stop();
+}
+
+TEST(TaskTest, LocalRunLoop)
+{
+    LocalRunLoop loop;
+    loop.init("LocalTask");
+
+    int out = 0;
+    auto done = spawn(loop, localMain(loop, out));
+    loop.run();
+
+    EXPECT_TRUE(done.isReady());
+    EXPECT_EQ(out, 7);
+}